@@ -0,0 +1,310 @@
+/***************************************************************************
+* SequenceBatch is an edit log for the Sequence. Inserts and removals are
+* queued with the same (key, info, occurrence) addressing as the Sequence
+* methods, and then applied in order with apply(...).
+*
+* The final sequence is the same as if the commands were called one by one,
+* but every command is resolved with a single walk (instead of exists,
+* howMany and the occurrence walk), and consecutive commands addressed to
+* the same element continue the walk from where the previous one stopped.
+* All new nodes are allocated before the sequence is touched, so a failed
+* allocation leaves the sequence unchanged.
+*
+* Nomenclature:
+ * command -> single queued insertAfter, insertBefore or remove
+ * cursor  -> node at which the walk of the previous command stopped
+****************************************************************************/
+
+#ifndef SEQUENCE_BATCH_H
+#define SEQUENCE_BATCH_H
+
+#include <vector>
+#include "sequence.h"
+
+
+template <typename Key, typename Info>
+class SequenceBatch {
+
+private:
+    typedef typename Sequence<Key, Info>::template Node<Key, Info> SeqNode;
+
+    enum CommandType { INSERT_AFTER, INSERT_BEFORE, REMOVE };
+
+    struct Command {
+        CommandType type;
+
+        Key key;
+        Info info;
+        int occurrence;
+
+        Key newKey;
+        Info newInfo;
+
+        //constructor for Command
+        Command(CommandType t, const Key &k, const Info &i, int o, const Key &nk, const Info &ni){
+            type = t;
+            key = k;
+            info = i;
+            occurrence = o;
+            newKey = nk;
+            newInfo = ni;
+        }
+    };
+
+    std::vector<Command> commands;
+    std::vector<bool> results;
+
+public:
+
+
+    /***************************************************************************
+    *  MEMBER FUNCTIONS
+    ****************************************************************************/
+
+    // default constructor
+    SequenceBatch();
+
+
+    /***************************************************************************
+    *  CAPACITY
+    ****************************************************************************/
+
+    bool isEmpty() const;
+    // RETURNS:
+    //    true, if there are no queued commands
+    //    false, if at least 1 command is queued
+
+    unsigned int size() const;
+    // RETURNS:
+    //    number of queued commands
+
+
+/***************************************************************************
+*  MODIFIERS
+****************************************************************************/
+
+    void insertAfter(const Key &key, const Info &info, const Key &newKey, const Info &newInfo, int occurrence = 1);
+    // queues Sequence::insertAfter
+    // PARAMETERS: same as in Sequence::insertAfter
+
+    void insertBefore(const Key &key, const Info &info, const Key &newKey, const Info &newInfo, int occurrence = 1);
+    // queues Sequence::insertBefore
+    // PARAMETERS: same as in Sequence::insertBefore
+
+    void remove(const Key &key, const Info &info, int occurrence = 1);
+    // queues Sequence::remove
+    // PARAMETERS: same as in Sequence::remove
+
+    void clear();
+    // removes every queued command and the results of the last apply(...)
+
+/***************************************************************************
+*  OPERATIONS
+****************************************************************************/
+
+    unsigned int apply(Sequence<Key, Info> &sequence);
+    // applies every queued command to the sequence, in the order of queuing
+    // PARAMETERS: sequence to modify
+    // RETURNS: number of commands that were successful
+
+    bool succeeded(unsigned int index) const;
+    // PARAMETERS: index of the command (in the order of queuing)
+    // RETURNS:
+    //    true, if the command was successful in the last apply(...)
+    //    false, if it wasn't, or if it hasn't been applied yet
+
+};
+
+
+/***********************************************************************
+*   IMPLEMENTATION
+************************************************************************/
+
+
+
+template<typename Key, typename Info>
+SequenceBatch<Key, Info>::SequenceBatch() {
+
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SequenceBatch<Key, Info>::isEmpty() const {
+
+    return commands.empty();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+unsigned int SequenceBatch<Key, Info>::size() const {
+
+    return commands.size();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceBatch<Key, Info>::insertAfter(const Key &key, const Info &info, const Key &newKey,
+                                           const Info &newInfo, int occurrence) {
+
+    commands.push_back(Command(INSERT_AFTER, key, info, occurrence, newKey, newInfo));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceBatch<Key, Info>::insertBefore(const Key &key, const Info &info, const Key &newKey,
+                                            const Info &newInfo, int occurrence) {
+
+    commands.push_back(Command(INSERT_BEFORE, key, info, occurrence, newKey, newInfo));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceBatch<Key, Info>::remove(const Key &key, const Info &info, int occurrence) {
+
+    //new key and info are unused for removal
+    commands.push_back(Command(REMOVE, key, info, occurrence, Key(), Info()));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceBatch<Key, Info>::clear() {
+
+    commands.clear();
+    results.clear();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SequenceBatch<Key, Info>::succeeded(unsigned int index) const {
+
+    if(index >= results.size())
+        return false;
+
+    return results[index];
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+unsigned int SequenceBatch<Key, Info>::apply(Sequence<Key, Info> &sequence) {
+
+    results.assign(commands.size(), false);
+
+    //allocating the nodes of every insert before touching the sequence
+    std::vector<SeqNode*> newNodes(commands.size(), (SeqNode*)NULL);
+    try {
+        for(unsigned int i = 0; i < commands.size(); i++){
+            if(commands[i].type != REMOVE)
+                newNodes[i] = new SeqNode(commands[i].newKey, commands[i].newInfo);
+        }
+    }
+    catch (const std::bad_alloc &) {
+        std::cerr << "Failed allocating memory for the new nodes" << std::endl;
+        for(unsigned int i = 0; i < newNodes.size(); i++)
+            delete newNodes[i];
+        return 0;
+    }
+
+    //cursor of the walk: travel is the current node, previous the one
+    //before it (NULL on the head), seen - how many elements of the cursor's
+    //key and info are placed before travel
+    SeqNode *travel = NULL;
+    SeqNode *previous = NULL;
+    int seen = 0;
+    bool cursorValid = false;
+    Key cursorKey = Key();
+    Info cursorInfo = Info();
+
+    unsigned int successful = 0;
+
+    for(unsigned int i = 0; i < commands.size(); i++){
+
+        const Command &command = commands[i];
+        int occurrence = command.occurrence < 1 ? 1 : command.occurrence;
+
+        //the sought element isn't before the cursor, continuing from it
+        if(!(cursorValid && cursorKey == command.key && cursorInfo == command.info && occurrence > seen)){
+            travel = sequence.head;
+            previous = NULL;
+            seen = 0;
+        }
+
+        //finding the given occurrence of the element
+        while(travel != NULL){
+            if(travel->key == command.key && travel->info == command.info){
+                seen++;
+                if(seen == occurrence)
+                    break;
+            }
+            previous = travel;
+            travel = travel->next;
+        }
+
+        if(travel == NULL){
+            if(seen == 0)
+                std::cerr << "Couldn't find element: {" << command.key << ", " << command.info << "}" << std::endl;
+            else
+                std::cerr << "Occurrence index out of bounds (" << command.occurrence << ")." << std::endl;
+
+            cursorValid = false;
+            continue;
+        }
+
+        //travel points at the sought element, seen counts it
+        seen--;
+
+        if(command.type == INSERT_AFTER){
+            newNodes[i]->next = travel->next;
+            travel->next = newNodes[i];
+        }
+        else if(command.type == INSERT_BEFORE){
+            newNodes[i]->next = travel;
+            if(previous == NULL)
+                sequence.head = newNodes[i];
+            else
+                previous->next = newNodes[i];
+
+            //new node may be the next sought element as well
+            travel = newNodes[i];
+        }
+        else{
+            SeqNode *temp = travel;
+            if(previous == NULL)
+                sequence.head = travel->next;
+            else
+                previous->next = travel->next;
+
+            travel = travel->next;
+            sequence.destroyNode(temp);
+        }
+
+        newNodes[i] = NULL;
+        results[i] = true;
+        successful++;
+
+        cursorValid = true;
+        cursorKey = command.key;
+        cursorInfo = command.info;
+    }
+
+    //nodes of the unsuccessful inserts
+    for(unsigned int i = 0; i < newNodes.size(); i++)
+        delete newNodes[i];
+
+    //counted only now, automatic compaction would move the cursor's nodes
+    sequence.edited(successful);
+
+    return successful;
+}
+
+//--------------------------------------------------------------------------
+
+
+#endif //SEQUENCE_BATCH_H
@@ -0,0 +1,412 @@
+/***************************************************************************
+* SequenceInterleave generalizes shuffle(...) to any number of sequences.
+* Every source is added with its own start index, block length and weight,
+* and then the sources are interleaved in cycles, in one pass with a single
+* cursor per source (no getNode(...) calls, no pushBack(...) walks).
+*
+* In every cycle each source takes as many turns as its weight, and the
+* turns of different sources are spread evenly (weights 3 and 1 give turns
+* A A B A). In every turn the source gives the next block of its elements.
+*
+* Sources added as rvalues are consumed: their nodes are taken over when
+* they're added, and toSequence(...) moves them into the output instead of
+* copying them.
+*
+* Nomenclature:
+ * source -> sequence with its start index, block length and weight
+ * turn   -> single block taken from one source
+ * cycle  -> every source taking its turns once (sum of weights turns)
+****************************************************************************/
+
+#ifndef SEQUENCE_INTERLEAVE_H
+#define SEQUENCE_INTERLEAVE_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "sequence.h"
+
+
+template <typename Key, typename Info>
+class SequenceInterleave {
+
+private:
+    typedef typename Sequence<Key, Info>::template Node<Key, Info> SeqNode;
+
+    struct Source {
+        const Sequence<Key, Info> *sequence;
+        std::shared_ptr<Sequence<Key, Info> > consumed;   // owned nodes, empty if the source is copied
+
+        unsigned int start;
+        unsigned int length;
+        unsigned int weight;
+    };
+
+    std::vector<Source> sources;
+
+    void addSource(const Sequence<Key, Info> &sequence, const std::shared_ptr<Sequence<Key, Info> > &consumed,
+                   unsigned int start, unsigned int length, unsigned int weight);
+    // checks the parameters and stores the source, used in add(...)
+    // THROWS: std::string in case of wrong input
+
+    std::vector<unsigned int> schedule() const;
+    // RETURNS: indexes of sources in order of their turns in a single cycle
+
+    template <typename Callback>
+    void run(unsigned int count, Callback callback) const;
+    // interleaves the sources without modifying them, callback(key, info) is
+    // called for every element, used in forEach and copy
+    // THROWS: std::string if count is 0
+
+public:
+
+
+    /***************************************************************************
+    *  MEMBER FUNCTIONS
+    ****************************************************************************/
+
+    // default constructor
+    SequenceInterleave();
+
+
+/***************************************************************************
+*  MODIFIERS
+****************************************************************************/
+
+    void add(const Sequence<Key, Info> &sequence, unsigned int start, unsigned int length,
+             unsigned int weight = 1);
+    // adds a source to copy the elements from
+    // PARAMETERS: sequence, starting index, how many elements are taken in a turn,
+    //             how many turns the source takes in a cycle, defaultly 1
+    // THROWS: std::string in case of wrong input (start out of bounds, length or weight 0)
+
+    void add(Sequence<Key, Info> &&sequence, unsigned int start, unsigned int length,
+             unsigned int weight = 1);
+    // adds a source to move the elements from in toSequence(...), every node
+    // of the sequence is taken over at once, so it's left empty
+    // PARAMETERS: same as above
+    // THROWS: std::string in case of wrong input (the sequence is left untouched then),
+    //         or if the sequence is already added to copy the elements from
+
+    void clear();
+    // removes every source
+
+/***************************************************************************
+*  OPERATIONS
+****************************************************************************/
+
+    Sequence<Key, Info> toSequence(unsigned int count);
+    // interleaves the sources, moving the nodes of consumed ones
+    // PARAMETERS: count - how many cycles
+    // RETURNS: a new, interleaved sequence
+    // THROWS: std::string if count is 0
+
+    template <typename Callback>
+    void forEach(unsigned int count, Callback callback) const;
+    // interleaves the sources, calling callback(key, info) for every element
+    // PARAMETERS: count - how many cycles, callback
+    // THROWS: std::string if count is 0
+
+    template <typename OutputIterator>
+    OutputIterator copy(unsigned int count, OutputIterator out) const;
+    // interleaves the sources, writing std::pair<Key, Info> of every element to out
+    // PARAMETERS: count - how many cycles, output iterator
+    // RETURNS: output iterator past the last written element
+    // THROWS: std::string if count is 0
+
+    /* EXAMPLE:
+     *  s1: 1 2 3 4 5 6 7 8
+     *  s2: 10 20 30 40 50 60 70 80 90 100
+     *  s3: 7 8 9
+     *  interleave.add(s1, 2, 2);
+     *  interleave.add(s2, 0, 3);
+     *  interleave.add(s3, 0, 1, 2);
+     *  interleave.toSequence(2): 7 3 4 10 20 30 8 9 5 6 40 50 60
+     */
+
+};
+
+
+/***********************************************************************
+*   IMPLEMENTATION
+************************************************************************/
+
+
+
+template<typename Key, typename Info>
+SequenceInterleave<Key, Info>::SequenceInterleave() {
+
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceInterleave<Key, Info>::addSource(const Sequence<Key, Info> &sequence,
+                                              const std::shared_ptr<Sequence<Key, Info> > &consumed,
+                                              unsigned int start, unsigned int length, unsigned int weight) {
+
+    if (sequence.length() < start) {
+        std::string lengthException = "Start index out of bounds.";
+        throw std::string(lengthException);
+    }
+
+    if (length == 0 || weight == 0) {
+        std::string lengthException = "Length and weight can't be equal to 0.";
+        throw std::string(lengthException);
+    }
+
+    Source source;
+    source.sequence = &sequence;
+    source.consumed = consumed;
+    source.start = start;
+    source.length = length;
+    source.weight = weight;
+
+    sources.push_back(source);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceInterleave<Key, Info>::add(const Sequence<Key, Info> &sequence, unsigned int start,
+                                        unsigned int length, unsigned int weight) {
+
+    addSource(sequence, std::shared_ptr<Sequence<Key, Info> >(), start, length, weight);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceInterleave<Key, Info>::add(Sequence<Key, Info> &&sequence, unsigned int start,
+                                        unsigned int length, unsigned int weight) {
+
+    //nodes of the consumed sequence are taken away, no copied source can walk it
+    for(unsigned int i = 0; i < sources.size(); i++){
+        if(sources[i].sequence == &sequence){
+            std::string sourceException = "Consumed sequence can't be added twice.";
+            throw std::string(sourceException);
+        }
+    }
+
+    //taking the nodes over, so the source doesn't depend on the lifetime of the argument
+    std::shared_ptr<Sequence<Key, Info> > owned(new Sequence<Key, Info>());
+    owned->head = sequence.head;
+    sequence.head = NULL;
+    owned->blocks.swap(sequence.blocks);
+    sequence.touched();
+
+    try {
+        addSource(*owned, owned, start, length, weight);
+    }
+    catch (...) {
+        sequence.head = owned->head;
+        owned->head = NULL;
+        sequence.blocks.swap(owned->blocks);
+        sequence.touched();
+        throw;
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SequenceInterleave<Key, Info>::clear() {
+
+    sources.clear();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+std::vector<unsigned int> SequenceInterleave<Key, Info>::schedule() const {
+
+    //smooth weighted round-robin: every turn each source gains its weight,
+    //the one with the most takes the turn and loses the total weight
+    std::vector<unsigned int> turns;
+    std::vector<long long> current(sources.size(), 0);
+
+    long long total = 0;
+    for(unsigned int i = 0; i < sources.size(); i++)
+        total += sources[i].weight;
+
+    for(long long turn = 0; turn < total; turn++){
+        unsigned int best = 0;
+        for(unsigned int i = 0; i < sources.size(); i++){
+            current[i] += sources[i].weight;
+            if(current[i] > current[best])
+                best = i;
+        }
+        current[best] -= total;
+        turns.push_back(best);
+    }
+
+    return turns;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Callback>
+void SequenceInterleave<Key, Info>::run(unsigned int count, Callback callback) const {
+
+    if (count == 0) {
+        std::string lengthException = "Count can't be equal to 0.";
+        throw std::string(lengthException);
+    }
+
+    std::vector<unsigned int> turns = schedule();
+
+    //setting up the cursors on the start indexes
+    std::vector<const SeqNode*> cursors(sources.size(), (const SeqNode*)NULL);
+    unsigned int active = 0;
+    for(unsigned int i = 0; i < sources.size(); i++){
+        const SeqNode *travel = sources[i].sequence->head;
+        for(unsigned int j = 0; travel != NULL && j < sources[i].start; j++)
+            travel = travel->next;
+
+        cursors[i] = travel;
+        if(travel != NULL) active++;
+    }
+
+    //number of cycles loop, until every source runs out of elements
+    for(unsigned int countNum = 0; countNum < count && active > 0; countNum++){
+        for(unsigned int t = 0; t < turns.size(); t++){
+
+            unsigned int s = turns[t];
+            if(cursors[s] == NULL) continue;
+
+            const SeqNode *travel = cursors[s];
+            for(unsigned int i = 0; travel != NULL && i < sources[s].length; i++){
+                callback(travel->key, travel->info);
+                travel = travel->next;
+            }
+
+            cursors[s] = travel;
+            if(travel == NULL) active--;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Callback>
+void SequenceInterleave<Key, Info>::forEach(unsigned int count, Callback callback) const {
+
+    run(count, callback);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename OutputIterator>
+OutputIterator SequenceInterleave<Key, Info>::copy(unsigned int count, OutputIterator out) const {
+
+    run(count, [&out](const Key &key, const Info &info){
+        *out = std::pair<Key, Info>(key, info);
+        ++out;
+    });
+
+    return out;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+Sequence<Key, Info> SequenceInterleave<Key, Info>::toSequence(unsigned int count) {
+
+    if (count == 0) {
+        std::string lengthException = "Count can't be equal to 0.";
+        throw std::string(lengthException);
+    }
+
+    //sequence to return
+    Sequence<Key, Info> outputSequence;
+    SeqNode *tail = NULL;
+
+    std::vector<unsigned int> turns = schedule();
+
+    //nodes left in the consumed sources (before the start, or after the last
+    //cycle) keep their blocks, so the blocks are shared with the output
+    for(unsigned int i = 0; i < sources.size(); i++){
+        if(sources[i].consumed)
+            outputSequence.adoptBlocks(*sources[i].consumed);
+    }
+
+    //cursors point at the links to the next taken node, so the consumed
+    //nodes can be unlinked from their sequences
+    std::vector<SeqNode**> consumedCursors(sources.size(), (SeqNode**)NULL);
+    std::vector<const SeqNode*> cursors(sources.size(), (const SeqNode*)NULL);
+    unsigned int active = 0;
+    for(unsigned int i = 0; i < sources.size(); i++){
+        if(sources[i].consumed){
+            SeqNode **link = &sources[i].consumed->head;
+            for(unsigned int j = 0; *link != NULL && j < sources[i].start; j++)
+                link = &(*link)->next;
+
+            consumedCursors[i] = link;
+            if(*link != NULL) active++;
+        }
+        else{
+            const SeqNode *travel = sources[i].sequence->head;
+            for(unsigned int j = 0; travel != NULL && j < sources[i].start; j++)
+                travel = travel->next;
+
+            cursors[i] = travel;
+            if(travel != NULL) active++;
+        }
+    }
+
+    //number of cycles loop, until every source runs out of elements
+    for(unsigned int countNum = 0; countNum < count && active > 0; countNum++){
+        for(unsigned int t = 0; t < turns.size(); t++){
+
+            unsigned int s = turns[t];
+
+            if(sources[s].consumed){
+                SeqNode **link = consumedCursors[s];
+                if(*link == NULL) continue;
+
+                for(unsigned int i = 0; *link != NULL && i < sources[s].length; i++){
+                    //moving the node from the source to the end of the output
+                    SeqNode *moved = *link;
+                    *link = moved->next;
+
+                    moved->next = NULL;
+                    if(tail == NULL)
+                        outputSequence.head = moved;
+                    else
+                        tail->next = moved;
+                    tail = moved;
+                }
+
+                if(*link == NULL) active--;
+            }
+            else{
+                const SeqNode *travel = cursors[s];
+                if(travel == NULL) continue;
+
+                for(unsigned int i = 0; travel != NULL && i < sources[s].length; i++){
+                    outputSequence.pushAfter(tail, travel->key, travel->info);
+                    travel = travel->next;
+                }
+
+                cursors[s] = travel;
+                if(travel == NULL) active--;
+            }
+        }
+    }
+
+    for(unsigned int i = 0; i < sources.size(); i++){
+        if(sources[i].consumed)
+            sources[i].consumed->touched();
+    }
+
+    return outputSequence;
+}
+
+//--------------------------------------------------------------------------
+
+
+#endif //SEQUENCE_INTERLEAVE_H
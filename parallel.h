@@ -0,0 +1,465 @@
+/***************************************************************************
+* Parallel algorithms over the Sequence. A linked list can't be split by
+* index, so the sequence is first cut into segments of about equal length
+* in a single walk (SequenceSegments), and then the segments are processed
+* by a group of threads, each taking the next free segment until none is
+* left. There are many more segments than threads, so a thread finishing
+* early takes over the work the others haven't started yet.
+*
+* Segments depend only on the length of the sequence (not on the number of
+* threads), and the partial results are combined in the order of segments,
+* so the results are deterministic. SequenceSegments can be kept and passed
+* again, as long as the sequence isn't modified in the meantime.
+*
+* The cut is the serial part of every call, so the sequence keeps the last
+* one and SequenceSegments reuse it until the links are modified (changing
+* keys and infos, as transformInPlace does, keeps it). Only the first call
+* after a modification walks the whole sequence on a single thread. The
+* cut is shared under a small mutex of the sequence, held only to take or
+* replace it (never while walking).
+*
+* Threads are taken from a pool started with the first call and kept until
+* the program ends, the pool grows when more threads are asked for. A call
+* made while the pool is busy (from a callback, or from another thread at
+* the same time) runs on the calling thread alone.
+*
+* Every callback takes (key, info) of the element, and is called from many
+* threads at once. Needs linking with -pthread.
+*
+* Nomenclature:
+ * segment -> part of the sequence between two stored iterators
+ * threads -> how many threads to use, 0 means hardware_concurrency()
+****************************************************************************/
+
+#ifndef SEQUENCE_PARALLEL_H
+#define SEQUENCE_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "sequence.h"
+
+
+template <typename Iterator>
+class SequenceSegments {
+
+private:
+    std::vector<Iterator> bounds;    // first element of every segment, and the end
+
+public:
+
+    // default number of segments
+    static const unsigned int DEFAULT_SEGMENTS = 256;
+
+    template <typename Key, typename Info>
+    explicit SequenceSegments(Sequence<Key, Info> &sequence, unsigned int segments = DEFAULT_SEGMENTS);
+    template <typename Key, typename Info>
+    explicit SequenceSegments(const Sequence<Key, Info> &sequence, unsigned int segments = DEFAULT_SEGMENTS);
+    // cuts the sequence into segments, or takes the last cut of the sequence
+    // if it hasn't been modified since (segments of a const sequence can only
+    // be walked with const_iterator)
+    // PARAMETERS: sequence, how many segments at least (if it's long enough)
+
+    unsigned int size() const;
+    // RETURNS: number of segments
+
+    Iterator begin(unsigned int segment) const;
+    Iterator end(unsigned int segment) const;
+    // RETURNS: iterators at the first element and past the last one of the segment
+
+};
+
+
+class SegmentPool {
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex guard;                 // protects every field below
+    std::condition_variable wake;     // workers wait for a job
+    std::condition_variable done;     // the caller waits for the workers to finish
+
+    const std::function<void()> *job;
+    unsigned int wanted;              // how many workers the job needs
+    unsigned int joined;              // how many of them have taken it
+    unsigned int running;             // how many of them are still running it
+    bool stopping;
+
+    std::mutex busy;                  // held for the whole run(...)
+
+    SegmentPool();
+    void work();
+    // loop of every worker
+
+public:
+    ~SegmentPool();
+
+    SegmentPool(const SegmentPool &) = delete;
+    SegmentPool &operator=(const SegmentPool &) = delete;
+
+    static SegmentPool &instance();
+    // RETURNS: the pool shared by every parallel algorithm
+
+    void run(unsigned int helpers, const std::function<void()> &task);
+    // calls task() on the current thread and on the given number of workers at
+    // once, returns when every one of them has finished, task mustn't throw
+    // PARAMETERS: helpers - how many workers at most, the pool grows if needed
+};
+
+
+template <typename Task>
+void runSegments(unsigned int segments, unsigned int threads, Task task);
+// calls task(segment) for every segment, on threads taking the next free one
+// THROWS: the first exception thrown by the task, after every thread has finished
+
+
+/***************************************************************************
+*  ALGORITHMS
+****************************************************************************/
+
+template <typename Key, typename Info, typename Function>
+void parallelForEach(const Sequence<Key, Info> &sequence, Function function, unsigned int threads = 0);
+// calls function(key, info) for every element
+
+template <typename Key, typename Info, typename Function>
+void transformInPlace(Sequence<Key, Info> &sequence, Function function, unsigned int threads = 0);
+// calls function(key, info) for every element, with key and info given by
+// reference, so they can be modified
+
+template <typename Key, typename Info, typename Accumulator, typename Function, typename Combine>
+Accumulator reduce(const Sequence<Key, Info> &sequence, Accumulator identity, Function function,
+                   Combine combine, unsigned int threads = 0);
+// PARAMETERS: identity - starting value of every segment,
+//             function(accumulator, key, info) - returns accumulator with the element added,
+//             combine(accumulator1, accumulator2) - joins results of neighbouring segments
+// RETURNS: results of the segments combined from the first one to the last one
+
+template <typename Key, typename Info, typename Predicate>
+unsigned int countIf(const Sequence<Key, Info> &sequence, Predicate predicate, unsigned int threads = 0);
+// RETURNS: how many elements there are, for which predicate(key, info) is true
+
+template <typename Key, typename Info, typename Predicate>
+bool findFirst(const Sequence<Key, Info> &sequence, Predicate predicate, Key &key, Info &info,
+               unsigned int threads = 0);
+// finds the first element (in the order of the sequence), for which predicate(key, info) is true
+// PARAMETERS: key and info to store the found ones
+// RETURNS: true if the element was found, false otherwise
+
+///every algorithm has the overload taking SequenceSegments of the sequence instead
+///of the sequence itself, to skip cutting it again
+
+
+/***********************************************************************
+*   IMPLEMENTATION
+************************************************************************/
+
+
+
+template<typename Iterator>
+template<typename Key, typename Info>
+SequenceSegments<Iterator>::SequenceSegments(Sequence<Key, Info> &sequence, unsigned int segments) {
+
+    typedef typename Sequence<Key, Info>::template Node<Key, Info> SeqNode;
+
+    std::shared_ptr<const typename Sequence<Key, Info>::SegmentCache> cut = sequence.segmentBounds(segments);
+
+    //the sequence isn't const, so its nodes can be given to iterator as well
+    bounds.reserve(cut->bounds.size());
+    for(unsigned int i = 0; i < cut->bounds.size(); i++)
+        bounds.push_back(Iterator(const_cast<SeqNode*>(cut->bounds[i])));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Iterator>
+template<typename Key, typename Info>
+SequenceSegments<Iterator>::SequenceSegments(const Sequence<Key, Info> &sequence, unsigned int segments) {
+
+    static_assert(std::is_same<Iterator, typename Sequence<Key, Info>::const_iterator>::value,
+                  "segments of a const sequence need Sequence::const_iterator");
+
+    std::shared_ptr<const typename Sequence<Key, Info>::SegmentCache> cut = sequence.segmentBounds(segments);
+
+    bounds.reserve(cut->bounds.size());
+    for(unsigned int i = 0; i < cut->bounds.size(); i++)
+        bounds.push_back(Iterator(cut->bounds[i]));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Iterator>
+unsigned int SequenceSegments<Iterator>::size() const {
+
+    return bounds.size() - 1;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Iterator>
+Iterator SequenceSegments<Iterator>::begin(unsigned int segment) const {
+
+    return bounds[segment];
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Iterator>
+Iterator SequenceSegments<Iterator>::end(unsigned int segment) const {
+
+    return bounds[segment + 1];
+}
+
+//--------------------------------------------------------------------------
+
+inline SegmentPool::SegmentPool() {
+
+    job = NULL;
+    wanted = 0;
+    joined = 0;
+    running = 0;
+    stopping = false;
+}
+
+//--------------------------------------------------------------------------
+
+inline SegmentPool::~SegmentPool() {
+
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+//--------------------------------------------------------------------------
+
+inline SegmentPool &SegmentPool::instance() {
+
+    static SegmentPool pool;
+    return pool;
+}
+
+//--------------------------------------------------------------------------
+
+inline void SegmentPool::work() {
+
+    std::unique_lock<std::mutex> lock(guard);
+    while(true){
+        wake.wait(lock, [this](){ return stopping || joined < wanted; });
+        if(stopping)
+            return;
+
+        joined++;
+        running++;
+        const std::function<void()> *current = job;
+
+        lock.unlock();
+        (*current)();
+        lock.lock();
+
+        if(--running == 0)
+            done.notify_all();
+    }
+}
+
+//--------------------------------------------------------------------------
+
+inline void SegmentPool::run(unsigned int helpers, const std::function<void()> &task) {
+
+    std::unique_lock<std::mutex> owner(busy, std::try_to_lock);
+    if(!owner.owns_lock() || helpers == 0){
+        task();
+        return;
+    }
+
+    //workers are only started, never stopped until the end of the program
+    while(workers.size() < helpers)
+        workers.push_back(std::thread(&SegmentPool::work, this));
+
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        job = &task;
+        wanted = helpers;
+        joined = 0;
+    }
+    wake.notify_all();
+
+    task();
+
+    //the job is finished by now, workers that haven't taken it yet mustn't start it
+    std::unique_lock<std::mutex> lock(guard);
+    wanted = joined;
+    done.wait(lock, [this](){ return running == 0; });
+    job = NULL;
+}
+
+//--------------------------------------------------------------------------
+
+template <typename Task>
+void runSegments(unsigned int segments, unsigned int threads, Task task){
+
+    if(segments == 0)
+        return;
+
+    if(threads == 0) threads = std::thread::hardware_concurrency();
+    if(threads == 0) threads = 1;
+    if(threads > segments) threads = segments;
+
+    std::atomic<unsigned int> next(0);
+    std::exception_ptr error;
+    std::atomic<bool> failed(false);
+
+    auto worker = [&](){
+        unsigned int segment;
+        while(!failed && (segment = next++) < segments){
+            try {
+                task(segment);
+            }
+            catch (...) {
+                //only the first exception is kept
+                if(!failed.exchange(true))
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    //current thread is one of the workers
+    SegmentPool::instance().run(threads - 1, std::function<void()>(worker));
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+//--------------------------------------------------------------------------
+
+template <typename Iterator, typename Function>
+void parallelForEach(const SequenceSegments<Iterator> &segments, Function function, unsigned int threads = 0){
+
+    runSegments(segments.size(), threads, [&](unsigned int segment){
+        for(Iterator travel = segments.begin(segment); travel != segments.end(segment); ++travel)
+            function(travel.key(), travel.info());
+    });
+}
+
+template <typename Key, typename Info, typename Function>
+void parallelForEach(const Sequence<Key, Info> &sequence, Function function, unsigned int threads){
+
+    parallelForEach(SequenceSegments<typename Sequence<Key, Info>::const_iterator>(sequence), function, threads);
+}
+
+//--------------------------------------------------------------------------
+
+template <typename Iterator, typename Function>
+void transformInPlace(const SequenceSegments<Iterator> &segments, Function function, unsigned int threads = 0){
+
+    parallelForEach(segments, function, threads);
+}
+
+template <typename Key, typename Info, typename Function>
+void transformInPlace(Sequence<Key, Info> &sequence, Function function, unsigned int threads){
+
+    parallelForEach(SequenceSegments<typename Sequence<Key, Info>::iterator>(sequence), function, threads);
+}
+
+//--------------------------------------------------------------------------
+
+template <typename Iterator, typename Accumulator, typename Function, typename Combine>
+Accumulator reduce(const SequenceSegments<Iterator> &segments, Accumulator identity, Function function,
+                   Combine combine, unsigned int threads = 0){
+
+    std::vector<Accumulator> partial(segments.size(), identity);
+
+    runSegments(segments.size(), threads, [&](unsigned int segment){
+        Accumulator accumulator = identity;
+        for(Iterator travel = segments.begin(segment); travel != segments.end(segment); ++travel)
+            accumulator = function(accumulator, travel.key(), travel.info());
+        partial[segment] = accumulator;
+    });
+
+    //combining in the order of segments, so the result doesn't depend on threads
+    Accumulator result = identity;
+    for(unsigned int i = 0; i < partial.size(); i++)
+        result = combine(result, partial[i]);
+
+    return result;
+}
+
+template <typename Key, typename Info, typename Accumulator, typename Function, typename Combine>
+Accumulator reduce(const Sequence<Key, Info> &sequence, Accumulator identity, Function function,
+                   Combine combine, unsigned int threads){
+
+    return reduce(SequenceSegments<typename Sequence<Key, Info>::const_iterator>(sequence),
+                  identity, function, combine, threads);
+}
+
+//--------------------------------------------------------------------------
+
+template <typename Iterator, typename Predicate>
+unsigned int countIf(const SequenceSegments<Iterator> &segments, Predicate predicate, unsigned int threads = 0){
+
+    return reduce(segments, 0u,
+                  [&](unsigned int count, const decltype(Iterator().key()) &key, const decltype(Iterator().info()) &info){
+                      return predicate(key, info) ? count + 1 : count;
+                  },
+                  [](unsigned int count1, unsigned int count2){ return count1 + count2; },
+                  threads);
+}
+
+template <typename Key, typename Info, typename Predicate>
+unsigned int countIf(const Sequence<Key, Info> &sequence, Predicate predicate, unsigned int threads){
+
+    return countIf(SequenceSegments<typename Sequence<Key, Info>::const_iterator>(sequence), predicate, threads);
+}
+
+//--------------------------------------------------------------------------
+
+template <typename Iterator, typename Key, typename Info, typename Predicate>
+bool findFirst(const SequenceSegments<Iterator> &segments, Predicate predicate, Key &key, Info &info,
+               unsigned int threads = 0){
+
+    //lowest segment with the element found so far, segments after it stop
+    std::atomic<unsigned int> best(segments.size());
+    std::vector<Iterator> found(segments.size());
+
+    runSegments(segments.size(), threads, [&](unsigned int segment){
+        for(Iterator travel = segments.begin(segment); travel != segments.end(segment); ++travel){
+            if(best < segment) return;
+
+            if(predicate(travel.key(), travel.info())){
+                found[segment] = travel;
+
+                unsigned int current = best;
+                while(segment < current && !best.compare_exchange_weak(current, segment));
+                return;
+            }
+        }
+    });
+
+    if(best == segments.size())
+        return false;
+
+    key = found[best].key();
+    info = found[best].info();
+    return true;
+}
+
+template <typename Key, typename Info, typename Predicate>
+bool findFirst(const Sequence<Key, Info> &sequence, Predicate predicate, Key &key, Info &info,
+               unsigned int threads){
+
+    return findFirst(SequenceSegments<typename Sequence<Key, Info>::const_iterator>(sequence),
+                     predicate, key, info, threads);
+}
+
+//--------------------------------------------------------------------------
+
+
+#endif //SEQUENCE_PARALLEL_H
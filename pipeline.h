@@ -0,0 +1,386 @@
+/***************************************************************************
+* Lazy adapters over the Sequence (or over any range of key-info pairs,
+* like ShuffleView or another adapter). An adapter only keeps its source
+* and parameters, and the elements are computed while it's iterated, so
+* nested adapters walk the source sequence once, without intermediate
+* sequences. The final result is written with toSequence(...) or
+* appendTo(...), which adds at the end through Sequence::Appender.
+*
+* Every callback takes (key, info) of the element.
+*
+* Nomenclature:
+ * range   -> Sequence or an object with begin() and end(), whose iterator
+ *            gives a pair of key (first) and info (second)
+ * adapter -> lazy range made from another range
+****************************************************************************/
+    /* EXAMPLE:
+     *  s1: {1, a} {2, b} {3, c} {4, d} {5, e}
+     *  s2 = toSequence(take(transformKey(filter(s1, isOdd), square), 2));
+     *  s2: {1, a} {9, c}
+     */
+
+#ifndef SEQUENCE_PIPELINE_H
+#define SEQUENCE_PIPELINE_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "sequence.h"
+
+
+/***************************************************************************
+*  SOURCES
+****************************************************************************/
+
+template <typename Key, typename Info>
+class SequenceView {
+// range of the whole sequence, kept by pointer, so adapters don't copy it
+// (a temporary sequence is moved into the view, and shared by its copies)
+
+    const Sequence<Key, Info> *sequence;
+    std::shared_ptr<const Sequence<Key, Info> > owned;
+
+public:
+    typedef typename Sequence<Key, Info>::const_iterator iterator;
+
+    explicit SequenceView(const Sequence<Key, Info> &s) { sequence = &s; }
+
+    explicit SequenceView(Sequence<Key, Info> &&s) : owned(new Sequence<Key, Info>(std::move(s))) { sequence = owned.get(); }
+
+    iterator begin() const { return sequence->begin(); }
+    iterator end() const { return sequence->end(); }
+};
+
+
+template <typename Range>
+Range asView(const Range &range){
+    return range;
+}
+
+template <typename Key, typename Info>
+SequenceView<Key, Info> asView(const Sequence<Key, Info> &sequence){
+    return SequenceView<Key, Info>(sequence);
+}
+
+template <typename Key, typename Info>
+SequenceView<Key, Info> asView(Sequence<Key, Info> &&sequence){
+    return SequenceView<Key, Info>(std::move(sequence));
+}
+// RETURNS: view of the sequence (owning it, if it's a temporary),
+//          or the adapter itself (used by every adapter)
+
+
+/***************************************************************************
+*  ADAPTERS
+****************************************************************************/
+
+template <typename View, typename Predicate>
+class FilterView {
+// elements of the source for which predicate(key, info) is true
+
+    View source;
+    Predicate predicate;
+
+public:
+    typedef typename View::iterator SourceIterator;
+
+    class iterator {
+
+        SourceIterator travel, last;
+        const Predicate *predicate;
+
+        void skip() {
+            while(travel != last && !(*predicate)((*travel).first, (*travel).second))
+                ++travel;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef decltype(*std::declval<SourceIterator>()) reference;
+        typedef typename std::decay<reference>::type value_type;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() : predicate(NULL) {}
+        iterator(SourceIterator t, SourceIterator l, const Predicate *p) : travel(t), last(l), predicate(p) { skip(); }
+
+        reference operator*() const { return *travel; }
+        iterator &operator++() { ++travel; skip(); return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator &other) const { return travel == other.travel; }
+        bool operator!=(const iterator &other) const { return travel != other.travel; }
+    };
+
+    FilterView(const View &s, const Predicate &p) : source(s), predicate(p) {}
+
+    iterator begin() const { return iterator(source.begin(), source.end(), &predicate); }
+    iterator end() const { return iterator(source.end(), source.end(), &predicate); }
+};
+
+//--------------------------------------------------------------------------
+
+template <typename View, typename Function, bool onKey>
+class TransformView {
+// elements of the source with key (onKey) or info replaced by function(key, info)
+
+    View source;
+    Function function;
+
+public:
+    typedef typename View::iterator SourceIterator;
+    typedef typename std::decay<decltype((*std::declval<SourceIterator>()).first)>::type SourceKey;
+    typedef typename std::decay<decltype((*std::declval<SourceIterator>()).second)>::type SourceInfo;
+    typedef typename std::decay<decltype(std::declval<const Function&>()(std::declval<const SourceKey&>(),
+                                                                         std::declval<const SourceInfo&>()))>::type Result;
+
+    class iterator {
+
+        SourceIterator travel;
+        const Function *function;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<typename std::conditional<onKey, Result, SourceKey>::type,
+                          typename std::conditional<onKey, SourceInfo, Result>::type> value_type;
+        typedef value_type reference;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() : function(NULL) {}
+        iterator(SourceIterator t, const Function *f) : travel(t), function(f) {}
+
+        reference operator*() const {
+            return make(*travel, std::integral_constant<bool, onKey>());
+        }
+
+        iterator &operator++() { ++travel; return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator &other) const { return travel == other.travel; }
+        bool operator!=(const iterator &other) const { return travel != other.travel; }
+
+    private:
+        template <typename Element>
+        value_type make(const Element &element, std::true_type) const {
+            return value_type((*function)(element.first, element.second), element.second);
+        }
+
+        template <typename Element>
+        value_type make(const Element &element, std::false_type) const {
+            return value_type(element.first, (*function)(element.first, element.second));
+        }
+    };
+
+    TransformView(const View &s, const Function &f) : source(s), function(f) {}
+
+    iterator begin() const { return iterator(source.begin(), &function); }
+    iterator end() const { return iterator(source.end(), &function); }
+};
+
+//--------------------------------------------------------------------------
+
+template <typename View>
+class TakeView {
+// first count elements of the source (or less, if the source is shorter)
+
+    View source;
+    unsigned int count;
+
+public:
+    typedef typename View::iterator SourceIterator;
+
+    class iterator {
+
+        SourceIterator travel, last;
+        unsigned int left;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef decltype(*std::declval<SourceIterator>()) reference;
+        typedef typename std::decay<reference>::type value_type;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() : left(0) {}
+        iterator(SourceIterator t, SourceIterator l, unsigned int n) : travel(t), last(l), left(n) {}
+
+        bool done() const { return left == 0 || travel == last; }
+
+        reference operator*() const { return *travel; }
+
+        //the source isn't walked past the last taken element
+        iterator &operator++() { if(--left > 0) ++travel; return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator &other) const {
+            if(done() || other.done())
+                return done() && other.done();
+            return travel == other.travel;
+        }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+    };
+
+    TakeView(const View &s, unsigned int n) : source(s), count(n) {}
+
+    iterator begin() const { return iterator(source.begin(), source.end(), count); }
+    iterator end() const { return iterator(source.end(), source.end(), 0); }
+};
+
+//--------------------------------------------------------------------------
+
+template <typename View>
+class DropView {
+// elements of the source without the first count ones
+
+    View source;
+    unsigned int count;
+
+public:
+    typedef typename View::iterator iterator;
+
+    DropView(const View &s, unsigned int n) : source(s), count(n) {}
+
+    iterator begin() const {
+        iterator travel = source.begin(), last = source.end();
+        for(unsigned int i = 0; i < count && travel != last; i++)
+            ++travel;
+        return travel;
+    }
+    iterator end() const { return source.end(); }
+};
+
+//--------------------------------------------------------------------------
+
+template <typename View1, typename View2>
+class ZipView {
+// pairs of key of the first source and info of the second one,
+// as long as the shorter source
+
+    View1 source1;
+    View2 source2;
+
+public:
+    typedef typename View1::iterator SourceIterator1;
+    typedef typename View2::iterator SourceIterator2;
+
+    class iterator {
+
+        SourceIterator1 travel1, last1;
+        SourceIterator2 travel2, last2;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<typename std::decay<decltype((*std::declval<SourceIterator1>()).first)>::type,
+                          typename std::decay<decltype((*std::declval<SourceIterator2>()).second)>::type> value_type;
+        typedef value_type reference;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() {}
+        iterator(SourceIterator1 t1, SourceIterator1 l1, SourceIterator2 t2, SourceIterator2 l2)
+                : travel1(t1), last1(l1), travel2(t2), last2(l2) {}
+
+        bool done() const { return travel1 == last1 || travel2 == last2; }
+
+        reference operator*() const { return reference((*travel1).first, (*travel2).second); }
+        iterator &operator++() { ++travel1; ++travel2; return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator &other) const {
+            if(done() || other.done())
+                return done() && other.done();
+            return travel1 == other.travel1 && travel2 == other.travel2;
+        }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+    };
+
+    ZipView(const View1 &s1, const View2 &s2) : source1(s1), source2(s2) {}
+
+    iterator begin() const { return iterator(source1.begin(), source1.end(), source2.begin(), source2.end()); }
+    iterator end() const { return iterator(source1.end(), source1.end(), source2.end(), source2.end()); }
+};
+
+
+/***************************************************************************
+*  FUNCTIONS
+****************************************************************************/
+
+template <typename Range, typename Predicate>
+FilterView<decltype(asView(std::declval<Range>())), Predicate> filter(Range &&range, Predicate predicate){
+    return FilterView<decltype(asView(std::declval<Range>())), Predicate>(asView(std::forward<Range>(range)), predicate);
+}
+// RETURNS: adapter with elements for which predicate(key, info) is true
+
+template <typename Range, typename Function>
+TransformView<decltype(asView(std::declval<Range>())), Function, true> transformKey(Range &&range, Function function){
+    return TransformView<decltype(asView(std::declval<Range>())), Function, true>(asView(std::forward<Range>(range)), function);
+}
+// RETURNS: adapter with every key replaced by function(key, info)
+
+template <typename Range, typename Function>
+TransformView<decltype(asView(std::declval<Range>())), Function, false> transformInfo(Range &&range, Function function){
+    return TransformView<decltype(asView(std::declval<Range>())), Function, false>(asView(std::forward<Range>(range)), function);
+}
+// RETURNS: adapter with every info replaced by function(key, info)
+
+template <typename Range>
+TakeView<decltype(asView(std::declval<Range>()))> take(Range &&range, unsigned int count){
+    return TakeView<decltype(asView(std::declval<Range>()))>(asView(std::forward<Range>(range)), count);
+}
+// RETURNS: adapter with the first count elements
+
+template <typename Range>
+DropView<decltype(asView(std::declval<Range>()))> drop(Range &&range, unsigned int count){
+    return DropView<decltype(asView(std::declval<Range>()))>(asView(std::forward<Range>(range)), count);
+}
+// RETURNS: adapter without the first count elements
+
+template <typename Range1, typename Range2>
+ZipView<decltype(asView(std::declval<Range1>())), decltype(asView(std::declval<Range2>()))>
+zip(Range1 &&range1, Range2 &&range2){
+    return ZipView<decltype(asView(std::declval<Range1>())), decltype(asView(std::declval<Range2>()))>(
+            asView(std::forward<Range1>(range1)), asView(std::forward<Range2>(range2)));
+}
+// RETURNS: adapter with keys of range1 and infos of range2, as long as the shorter one
+
+//--------------------------------------------------------------------------
+
+template <typename Key, typename Info, typename Range>
+unsigned int appendTo(Range &&range, Sequence<Key, Info> &sequence){
+
+    typedef decltype(asView(std::declval<Range>())) View;
+
+    //iterators of adapters point into the view, so it has to outlive them
+    View view = asView(range);
+
+    typename Sequence<Key, Info>::Appender out = sequence.appender();
+    unsigned int count = 0;
+
+    for(typename View::iterator travel = view.begin(), last = view.end(); travel != last; ++travel){
+        if(out.push((*travel).first, (*travel).second))
+            count++;
+    }
+
+    return count;
+}
+// adds every element of the range at the end of the sequence, in a single walk
+// RETURNS: number of added elements
+
+template <typename Range>
+Sequence<typename std::decay<decltype((*asView(std::declval<Range>()).begin()).first)>::type,
+         typename std::decay<decltype((*asView(std::declval<Range>()).begin()).second)>::type>
+toSequence(const Range &range){
+
+    Sequence<typename std::decay<decltype((*asView(range).begin()).first)>::type,
+             typename std::decay<decltype((*asView(range).begin()).second)>::type> outputSequence;
+
+    appendTo(range, outputSequence);
+    return outputSequence;
+}
+// RETURNS: a new sequence with every element of the range
+
+
+#endif //SEQUENCE_PIPELINE_H
@@ -16,23 +16,69 @@
  * head -> first element of the list
  * Node -> structure of single element of the list
  *         (element of Key, element of Info, and pointer to next Node)
+ * Block -> single allocation holding many nodes next to each other,
+ *          made by compact(), owned by the sequences holding its nodes
 ****************************************************************************/
 
 #ifndef SEQUENCE_SEQUENCE_H
 #define SEQUENCE_SEQUENCE_H
 
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <new>
+#include <vector>
+#include <utility>
 #include <string.h>
 #include <stdlib.h>
 
 
+template <typename Key, typename Info>
+class SequenceBatch;
+
+template <typename Key, typename Info>
+class SequenceInterleave;
+
+template <typename Iterator>
+class SequenceSegments;
+
+template <typename Key, typename Info>
+class SharedSequence;
+
 
 template <typename Key, typename Info>
 class Sequence {
 
+    // batched edits relink nodes directly (see batch.h)
+    friend class SequenceBatch<Key, Info>;
+    // interleave splices nodes of consumed sources (see interleave.h)
+    friend class SequenceInterleave<Key, Info>;
+    // parallel algorithms reuse the cached segments (see parallel.h)
+    template <typename Iterator> friend class SequenceSegments;
+    // versions of a shared sequence link the same nodes (see shared.h)
+    friend class SharedSequence<Key, Info>;
+
 private:
+    struct Block {
+        void *memory;
+        unsigned int capacity;
+        std::atomic<unsigned int> alive;    // 0 once the memory is freed
+    };
+    // memory of the compacted nodes, freed when the last of them is destroyed
+    // (sequences sharing a block can destroy their nodes from different threads)
+
+    struct BlockLess {
+        bool operator()(const std::shared_ptr<Block> &block1, const std::shared_ptr<Block> &block2) const {
+            return (std::uintptr_t)block1->memory < (std::uintptr_t)block2->memory;
+        }
+    };
+
     template <typename aKey, typename aInfo>
     struct Node {
         aKey key;
@@ -46,32 +92,117 @@ private:
             info = i;
             next = NULL;
         }
+
+        //constructor for Node, taking over key and info (given back if it fails)
+        Node(aKey &&k, aInfo &&i){
+            key = std::move(k);
+            try {
+                info = std::move(i);
+            }
+            catch (...) {
+                k = std::move(key);
+                throw;
+            }
+            next = NULL;
+        }
     };
 
     Node<Key, Info> *head;
 
+    std::vector<std::shared_ptr<Block> > blocks;    // blocks holding nodes of the sequence, sorted
+                                                    // by address (nodes out of them are on their own)
+
+    unsigned int edits;              // edits since the last compaction
+    unsigned int compactThreshold;   // edits triggering the compaction, 0 if never
+
+    unsigned long revision;          // changes with every modification of the links
+
+    struct SegmentCache {
+        unsigned long revision;
+        unsigned int segments;
+        std::vector<const Node<Key, Info>*> bounds;    // first node of every segment, and NULL
+    };
+    // bounds of the parallel segments, valid while the revision is the same
+
+    mutable std::shared_ptr<const SegmentCache> segmentCache;
+    mutable std::mutex segmentLock;    // guards only the segmentCache pointer, held without walking
+
     /***************************************************************************
     *  PRIVATE METHODS TO SUPPORT PUBLIC ONES
     ****************************************************************************/
 
-    bool exists(const Key &key, const Info &info);
-    // RETURNS:
-    //    true, if the element exists in the sequence
-    //    false, if the element doesn't exist in the sequence
-    // PARAMETERS: key and info of sought node
-
-    int howMany(const Key key, const Info info);
-    // RETURNS:
-    //   an integer number of how much elements of given
-    //   key and info there are in the sequence
-    // PARAMETERS: key and info of sought node
-
     Sequence<Key, Info> merge(const Sequence<Key, Info> &sequence ) const;
     // merges two sequences together, used in operator+ and +=
     // RETURNS:
     //    a merged Sequence<Key, Info> type object
     // PARAMETERS: Sequence<Key, Info> type object
 
+    int findBlock(const Node<Key, Info> *node) const;
+    // RETURNS: index of the block holding the node, -1 if it's allocated on its own
+
+    void destroyNode(Node<Key, Info> *node);
+    // frees the node, or its place in the block, used instead of delete
+
+    void pruneBlocks();
+    // forgets the blocks freed by other sequences, so their addresses can't
+    // be mistaken for the ones of new blocks
+
+    void adoptBlocks(const Sequence<Key, Info> &sequence);
+    // shares the blocks of the sequence, used when its nodes are moved here
+
+    void edited(unsigned int count = 1);
+    // counts the edits, and compacts the sequence if there were enough of them
+
+    void touched();
+    // marks the links as modified, so the cached segments aren't used anymore
+
+    std::shared_ptr<const SegmentCache> segmentBounds(unsigned int segments) const;
+    // cuts the sequence into segments of about equal length in a single walk,
+    // or reuses the last cut, if the sequence hasn't been modified since
+    // PARAMETERS: how many segments at least (if the sequence is long enough)
+
+    static std::size_t allocationSize(std::size_t bytes);
+    // RETURNS: estimated heap memory taken by the allocation of given size
+    //          (8 bytes of header, 16 bytes alignment, like in a typical malloc)
+
+    void measure(std::size_t &bytes, double &fragmentation) const;
+    // estimates memory and fragmentation of the nodes, used in compact
+    // (blocks are marked when counted, so every node takes a single search)
+    // PARAMETERS: bytes and fragmentation to store the estimated ones
+
+    struct KeyLess {
+        bool operator()(const Key &key1, const Info &, const Key &key2, const Info &) const {
+            return key1 < key2;
+        }
+    };
+    // orders the nodes by key, used in sortByKey and the sorted operations
+
+    struct InfoLess {
+        bool operator()(const Key &, const Info &info1, const Key &, const Info &info2) const {
+            return info1 < info2;
+        }
+    };
+    // orders the nodes by info, used in sortByInfo
+
+    bool pushAfter(Node<Key, Info> *&tail, const Key &newKey, const Info &newInfo);
+    // inserts a new element after tail (or at the beginning if tail is NULL)
+    // and moves tail onto it, used to build sequences in linear time
+    // RETURNS:
+    //    true, if the insert was successful
+    //    false, if the element hasn't been added
+
+    static Node<Key, Info> *split(Node<Key, Info> *list, unsigned int count);
+    // cuts the list after count nodes
+    // RETURNS: the rest of the list (NULL if the list was shorter)
+
+    template <typename Compare>
+    static Node<Key, Info> *mergeNodes(Node<Key, Info> *left, Node<Key, Info> *right,
+                                       Node<Key, Info> **tail, Compare less);
+    // relinks two sorted lists into one, nodes of left go first among equal ones
+    // PARAMETERS: heads of the lists, tail to store the last node of result
+    //             (NULL if it's not needed), comparator less(key1, info1, key2, info2)
+    // RETURNS: head of the merged list
+
 
 public:
 
@@ -89,6 +220,9 @@ public:
     // copy constructor
     Sequence(const Sequence<Key, Info> &sequence);
 
+    // move constructor, takes over the nodes of the given sequence, leaving it empty
+    Sequence(Sequence<Key, Info> &&sequence);
+
     // assignment operator
     Sequence<Key, Info> &operator=(const Sequence<Key, Info> &sequence);
 
@@ -97,7 +231,7 @@ public:
     *  CAPACITY
     ****************************************************************************/
 
-    bool isEmpty();
+    bool isEmpty() const;
     // RETURNS:
     //    true, if the sequence has no elements
     //    false, if the sequence has at least 1 element
@@ -111,7 +245,7 @@ public:
 *  DISPLAY
 ****************************************************************************/
 
-    void print();
+    void print() const;
     // prints the sequence into the output stream
 
 /***************************************************************************
@@ -184,6 +318,33 @@ public:
     //    true, if the removal was successful
     //    false, if the removal was not successful
 
+/***************************************************************************
+*  MEMORY
+****************************************************************************/
+
+    struct CompactReport {
+        unsigned int nodes;            // number of moved nodes
+        std::size_t bytesBefore;       // estimated heap memory of the nodes
+        std::size_t bytesAfter;        //   before and after the compaction
+        std::size_t bytesReclaimed;    // bytesBefore - bytesAfter, 0 if it grew
+        double fragmentationBefore;    // fraction of links not pointing at the
+        double fragmentationAfter;     //   neighbouring node in memory
+    };
+
+    CompactReport compact();
+    // moves every node into one contiguous block, in the order of the sequence,
+    // and frees the old ones (iterators and appenders become invalid)
+    // RETURNS: estimated memory and fragmentation before and after
+    // THROWS: what moving Key or Info throws (the sequence is left unchanged then)
+
+    void setAutoCompact(unsigned int count);
+    // compacts the sequence after every given number of edits (pushFront,
+    // pushBack, insertAfter, insertBefore, remove), 0 turns it off
+    // PARAMETERS: number of edits
+
+    CompactReport lastCompact() const;
+    // RETURNS: report of the last compaction (zeros if there was none)
+
 /***************************************************************************
 *  OPERATIONS
 ****************************************************************************/
@@ -194,6 +355,192 @@ public:
     //             found ones
     // RETURNS: true if the node was found, false otherwise
 
+    bool exists(const Key &key, const Info &info) const;
+    // RETURNS:
+    //    true, if the element exists in the sequence
+    //    false, if the element doesn't exist in the sequence
+    // PARAMETERS: key and info of sought node
+
+    int howMany(const Key key, const Info info) const;
+    // RETURNS:
+    //   an integer number of how much elements of given
+    //   key and info there are in the sequence
+    // PARAMETERS: key and info of sought node
+
+/***************************************************************************
+*  ITERATORS
+****************************************************************************/
+
+    class iterator;
+
+    class const_iterator {
+    // walks the sequence from the given node, without modifying it
+    // (*iterator gives the pair of references to key and info)
+
+        friend class Sequence<Key, Info>;
+        friend class iterator;
+        template <typename Iterator> friend class SequenceSegments;
+
+        const Node<Key, Info> *node;
+
+        explicit const_iterator(const Node<Key, Info> *n) { node = n; }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Key, Info> value_type;
+        typedef std::pair<const Key&, const Info&> reference;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        const_iterator() { node = NULL; }
+
+        const Key &key() const { return node->key; }
+        const Info &info() const { return node->info; }
+
+        reference operator*() const { return reference(node->key, node->info); }
+
+        const_iterator &operator++() { node = node->next; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; node = node->next; return old; }
+
+        bool operator==(const const_iterator &other) const { return node == other.node; }
+        bool operator!=(const const_iterator &other) const { return node != other.node; }
+    };
+
+    class iterator {
+    // walks the sequence from the given node, key and info can be modified
+    // (*iterator gives the pair of references to key and info)
+
+        friend class Sequence<Key, Info>;
+
+        Node<Key, Info> *node;
+
+        explicit iterator(Node<Key, Info> *n) { node = n; }
+
+        template <typename Iterator> friend class SequenceSegments;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Key, Info> value_type;
+        typedef std::pair<Key&, Info&> reference;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() { node = NULL; }
+
+        operator const_iterator() const { return const_iterator(node); }
+
+        Key &key() const { return node->key; }
+        Info &info() const { return node->info; }
+
+        reference operator*() const { return reference(node->key, node->info); }
+
+        iterator &operator++() { node = node->next; return *this; }
+        iterator operator++(int) { iterator old = *this; node = node->next; return old; }
+
+        bool operator==(const iterator &other) const { return node == other.node; }
+        bool operator!=(const iterator &other) const { return node != other.node; }
+    };
+
+    class Appender {
+    // adds elements at the end of the sequence in constant time, the end is
+    // found once, so it's valid until the sequence is modified in other way
+    // (output iterator of std::pair<Key, Info>)
+
+        friend class Sequence<Key, Info>;
+
+        Sequence<Key, Info> *sequence;
+        Node<Key, Info> *tail;
+
+        explicit Appender(Sequence<Key, Info> &s) {
+            sequence = &s;
+            tail = NULL;
+            for(Node<Key, Info> *travel = s.head; travel != NULL; travel = travel->next)
+                tail = travel;
+        }
+
+    public:
+        typedef std::output_iterator_tag iterator_category;
+        typedef void value_type;
+        typedef void reference;
+        typedef void pointer;
+        typedef void difference_type;
+
+        bool push(const Key &newKey, const Info &newInfo) { return sequence->pushAfter(tail, newKey, newInfo); }
+
+        template <typename aKey, typename aInfo>
+        Appender &operator=(const std::pair<aKey, aInfo> &element) { push(element.first, element.second); return *this; }
+
+        Appender &operator*() { return *this; }
+        Appender &operator++() { return *this; }
+        Appender &operator++(int) { return *this; }
+    };
+
+    iterator begin();
+    const_iterator begin() const;
+    // RETURNS: iterator at the first element
+
+    iterator end();
+    const_iterator end() const;
+    // RETURNS: iterator past the last element
+
+    Appender appender();
+    // RETURNS: appender adding elements at the end of the sequence
+
+/***************************************************************************
+*  ORDERING
+****************************************************************************/
+
+    ///every comparator takes (key1, info1, key2, info2) and returns true if
+    ///the first element goes before the second one, like operator<.
+    ///sorted operations expect the sequences to be sorted with the same comparator.
+
+    void sortByKey();
+    // sorts the sequence by key, keeping the order of equal elements
+    // (nodes are relinked, nothing is allocated)
+
+    void sortByInfo();
+    // sorts the sequence by info, keeping the order of equal elements
+
+    template <typename Compare>
+    void sort(Compare less);
+    // sorts the sequence with the given comparator, keeping the order of equal elements
+    // PARAMETERS: comparator less(key1, info1, key2, info2)
+
+    void mergeSorted(Sequence<Key, Info> &sequence);
+    template <typename Compare>
+    void mergeSorted(Sequence<Key, Info> &sequence, Compare less);
+    // moves the nodes of the given sorted sequence into the current sorted one
+    // in linear time, the given sequence is left empty
+    // PARAMETERS: sequence to take the nodes from, optionally comparator (by key otherwise)
+
+    void removeDuplicates();
+    template <typename Compare>
+    void removeDuplicates(Compare less);
+    // removes every element equal to the one before it from the sorted sequence,
+    // so only the first one of equal elements is left
+    // PARAMETERS: optionally comparator (by key otherwise)
+
+    Sequence<Key, Info> unionSorted(const Sequence<Key, Info> &sequence) const;
+    template <typename Compare>
+    Sequence<Key, Info> unionSorted(const Sequence<Key, Info> &sequence, Compare less) const;
+    // PARAMETERS: another sorted sequence, optionally comparator (by key otherwise)
+    // RETURNS: new sorted sequence with elements of both, equal elements are taken
+    //          from the current one, as many times as in the sequence having more of them
+
+    Sequence<Key, Info> intersectionSorted(const Sequence<Key, Info> &sequence) const;
+    template <typename Compare>
+    Sequence<Key, Info> intersectionSorted(const Sequence<Key, Info> &sequence, Compare less) const;
+    // PARAMETERS: another sorted sequence, optionally comparator (by key otherwise)
+    // RETURNS: new sorted sequence with elements of the current one which are in
+    //          the given one too, as many times as in the sequence having less of them
+
+    Sequence<Key, Info> differenceSorted(const Sequence<Key, Info> &sequence) const;
+    template <typename Compare>
+    Sequence<Key, Info> differenceSorted(const Sequence<Key, Info> &sequence, Compare less) const;
+    // PARAMETERS: another sorted sequence, optionally comparator (by key otherwise)
+    // RETURNS: new sorted sequence with elements of the current one which aren't
+    //          in the given one (every equal element there cancels one of them)
+
     /***************************************************************************
     *  OPERATORS
     ****************************************************************************/
@@ -223,7 +570,8 @@ public:
     // RETURNS: current sequence with the given one merged to it
 
 
-
+private:
+    CompactReport compactReport;    // report of the last compaction
 
 };
 
@@ -235,7 +583,7 @@ public:
 
 
 template<typename Key, typename Info>
-bool Sequence<Key, Info>::exists(const Key &key, const Info &info) {
+bool Sequence<Key, Info>::exists(const Key &key, const Info &info) const {
 
     Node<Key, Info> *travel = head;
 
@@ -256,6 +604,10 @@ template<typename Key, typename Info>
 Sequence<Key, Info>::Sequence() {
 
     head = NULL;
+    edits = 0;
+    compactThreshold = 0;
+    revision = 0;
+    compactReport = CompactReport();
 
 }
 
@@ -276,12 +628,32 @@ template<typename Key, typename Info>
 Sequence<Key, Info>::Sequence(const Sequence<Key, Info> &sequence) {
 
     head = NULL;
+    edits = 0;
+    compactThreshold = 0;
+    revision = 0;
+    compactReport = CompactReport();
     *this = sequence;
 
 }
 
 //--------------------------------------------------------------------------
 
+template<typename Key, typename Info>
+Sequence<Key, Info>::Sequence(Sequence<Key, Info> &&sequence) {
+
+    head = sequence.head;
+    sequence.head = NULL;
+    blocks.swap(sequence.blocks);
+    sequence.touched();
+    edits = 0;
+    compactThreshold = 0;
+    revision = 0;
+    compactReport = CompactReport();
+
+}
+
+//--------------------------------------------------------------------------
+
 template<typename Key, typename Info>
 Sequence<Key, Info> &Sequence<Key, Info>::operator=(const Sequence<Key, Info> &sequence) {
 
@@ -291,9 +663,11 @@ Sequence<Key, Info> &Sequence<Key, Info>::operator=(const Sequence<Key, Info> &s
 
     clearSequence();
 
+    //keeping the last node, not to walk to the end for every element
+    Node<Key, Info> *tail = NULL;
     Node<Key, Info> *travel = sequence.head;
     while(travel != NULL){
-        this->pushBack(travel->key, travel->info);
+        this->pushAfter(tail, travel->key, travel->info);
         travel = travel->next;
     }
     return *this;
@@ -319,6 +693,7 @@ bool Sequence<Key, Info>::pushFront(const Key &newKey, const Info &newInfo) {
     newNode->next = head;
     head = newNode;
 
+    edited();
     return true;
 
 
@@ -357,6 +732,7 @@ bool Sequence<Key, Info>::pushBack(const Key &newKey, const Info &newInfo) {
     travel->next = newNode;
 
 
+    edited();
     return true;
 }
 
@@ -392,6 +768,8 @@ bool Sequence<Key, Info>::insertAfter(const Key &key, const Info &info, const Ke
 
         head->next = newNode;
         newNode->next = NULL;
+        edited();
+        return true;
     }
 
 
@@ -403,7 +781,6 @@ bool Sequence<Key, Info>::insertAfter(const Key &key, const Info &info, const Ke
 
             if(occurrence > 1){
                 occurrence--;
-                travel = travel->next;
             }
 
             else{
@@ -421,6 +798,7 @@ bool Sequence<Key, Info>::insertAfter(const Key &key, const Info &info, const Ke
                 newNode->next = travel->next;
                 travel->next = newNode;
 
+                edited();
                 return true;
             }
         }
@@ -462,11 +840,33 @@ bool Sequence<Key, Info>::insertBefore(const Key &key, const Info &info, const K
 
         newNode->next = head;
         head = newNode;
+        edited();
+        return true;
+    }
+
+    //sought element on the head of the sequence
+    if(head->key == key && head->info == info) {
+        if(occurrence <= 1) {
+            Node<Key, Info> *newNode;
+            try{
+                newNode = new Node<Key, Info>(newKey, newInfo);
+            }
+            catch(std::bad_alloc){
+                std::cerr << "Failed allocating memory for the new node" << std::endl;
+                return false;
+            }
+
+            newNode->next = head;
+            head = newNode;
+            edited();
+            return true;
+        }
+        else occurrence--;
     }
 
     //given element exists at least once
     Node<Key, Info> *travel = head;
-    while(travel != NULL){
+    while(travel->next != NULL){
 
         if(travel->next->key == key && travel->next->info == info){
 
@@ -488,6 +888,7 @@ bool Sequence<Key, Info>::insertBefore(const Key &key, const Info &info, const K
                 travel->next = newNode;
 
 
+                edited();
                 return true;
             }
         }
@@ -517,8 +918,9 @@ bool Sequence<Key, Info>::remove(const Key &key, const Info &info, int occurrenc
 
     //1 element list
     if(head->next == NULL && head->key == key && head->info == info && occurrence == 1){
-        delete head;
+        destroyNode(head);
         head = NULL;
+        edited();
         return true;
     }
 
@@ -531,8 +933,9 @@ bool Sequence<Key, Info>::remove(const Key &key, const Info &info, int occurrenc
         if(occurrence == 1) {
             Node<Key, Info> *temp = head;
             head = travel->next;
-            delete temp;
+            destroyNode(temp);
 
+            edited();
             return true;
         }
         else occurrence--;
@@ -546,7 +949,8 @@ bool Sequence<Key, Info>::remove(const Key &key, const Info &info, int occurrenc
         if(occurrence == 1) {
             Node<Key, Info> *temp = travel->next;
             travel->next = travel->next->next;
-            delete temp;
+            destroyNode(temp);
+            edited();
             return true;
         }
         else occurrence--;
@@ -587,9 +991,10 @@ bool Sequence<Key, Info>::clearSequence() {
     while(travel != NULL){
         temp = travel;
         travel = travel->next;
-        delete temp;
+        destroyNode(temp);
     }
     head = NULL;
+    touched();
     return true;
 }
 
@@ -619,7 +1024,7 @@ bool Sequence<Key, Info>::getNode(unsigned int index, Key &key, Info &info) cons
 
 
 template<typename Key, typename Info>
-bool Sequence<Key, Info>::isEmpty() {
+bool Sequence<Key, Info>::isEmpty() const {
 
     return (head == NULL);
 }
@@ -643,7 +1048,7 @@ unsigned int Sequence<Key, Info>::length() const {
 //--------------------------------------------------------------------------
 
 template<typename Key, typename Info>
-void Sequence<Key, Info>::print() {
+void Sequence<Key, Info>::print() const {
 
     Node<Key, Info> *travel = head;
     while(travel != NULL){
@@ -735,7 +1140,7 @@ Sequence<Key, Info> Sequence<Key, Info>::merge( const Sequence<Key, Info> &seque
 //--------------------------------------------------------------------------
 
 template<typename Key, typename Info>
-int Sequence<Key, Info>::howMany(const Key key, const Info info) {
+int Sequence<Key, Info>::howMany(const Key key, const Info info) const {
 
     if(head == NULL) return 0;
 
@@ -752,5 +1157,661 @@ int Sequence<Key, Info>::howMany(const Key key, const Info info) {
 
 //--------------------------------------------------------------------------
 
+template<typename Key, typename Info>
+bool Sequence<Key, Info>::pushAfter(Node<Key, Info> *&tail, const Key &newKey, const Info &newInfo) {
+
+    touched();
+
+    Node<Key, Info> *newNode;
+    try {
+        newNode = new Node<Key, Info>(newKey, newInfo);
+    }
+    catch (const std::bad_alloc &) {
+        std::cerr << "Failed allocating memory for the new node" << std::endl;
+        return false;
+    }
+
+    if(tail == NULL){
+        newNode->next = head;
+        head = newNode;
+    }
+    else{
+        newNode->next = tail->next;
+        tail->next = newNode;
+    }
+
+    tail = newNode;
+    return true;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::template Node<Key, Info> *
+Sequence<Key, Info>::split(Node<Key, Info> *list, unsigned int count) {
+
+    for(unsigned int i = 1; list != NULL && i < count; i++){
+        list = list->next;
+    }
+
+    if(list == NULL)
+        return NULL;
+
+    Node<Key, Info> *rest = list->next;
+    list->next = NULL;
+    return rest;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+typename Sequence<Key, Info>::template Node<Key, Info> *
+Sequence<Key, Info>::mergeNodes(Node<Key, Info> *left, Node<Key, Info> *right,
+                                Node<Key, Info> **tail, Compare less) {
+
+    Node<Key, Info> *merged = NULL;
+    Node<Key, Info> **link = &merged;
+    Node<Key, Info> *last = NULL;
+
+    //taking from the right one only if it's strictly smaller, so the merge is stable
+    while(left != NULL && right != NULL){
+        if(less(right->key, right->info, left->key, left->info)){
+            *link = right;
+            right = right->next;
+        }
+        else{
+            *link = left;
+            left = left->next;
+        }
+        last = *link;
+        link = &last->next;
+    }
+
+    *link = (left != NULL) ? left : right;
+
+    //only the leftover run is walked to find the last node
+    if(tail != NULL){
+        for(Node<Key, Info> *travel = *link; travel != NULL; travel = travel->next){
+            last = travel;
+        }
+        *tail = last;
+    }
+
+    return merged;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::iterator Sequence<Key, Info>::begin() {
+
+    return iterator(head);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::iterator Sequence<Key, Info>::end() {
+
+    return iterator(NULL);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::const_iterator Sequence<Key, Info>::begin() const {
+
+    return const_iterator(head);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::const_iterator Sequence<Key, Info>::end() const {
+
+    return const_iterator(NULL);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::Appender Sequence<Key, Info>::appender() {
+
+    return Appender(*this);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::sortByKey() {
+
+    sort(KeyLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::sortByInfo() {
+
+    sort(InfoLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+void Sequence<Key, Info>::sort(Compare less) {
+
+    if(head == NULL || head->next == NULL)
+        return;
+
+    unsigned int size = length();
+
+    //bottom-up: merging neighbouring runs of width 1, 2, 4, ... in place
+    for(unsigned int width = 1; width < size; width *= 2){
+
+        Node<Key, Info> **link = &head;
+        Node<Key, Info> *rest = head;
+
+        while(rest != NULL){
+            Node<Key, Info> *left = rest;
+            Node<Key, Info> *right = split(left, width);
+            rest = split(right, width);
+
+            Node<Key, Info> *tail;
+            *link = mergeNodes(left, right, &tail, less);
+            link = &tail->next;
+        }
+    }
+
+    touched();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::mergeSorted(Sequence<Key, Info> &sequence) {
+
+    mergeSorted(sequence, KeyLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+void Sequence<Key, Info>::mergeSorted(Sequence<Key, Info> &sequence, Compare less) {
+
+    if(this == &sequence)
+        return;
+
+    //adopted first, nothing is moved if it fails
+    adoptBlocks(sequence);
+    sequence.blocks.clear();
+
+    head = mergeNodes(head, sequence.head, (Node<Key, Info>**)NULL, less);
+    sequence.head = NULL;
+
+    touched();
+    sequence.touched();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::removeDuplicates() {
+
+    removeDuplicates(KeyLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+void Sequence<Key, Info>::removeDuplicates(Compare less) {
+
+    if(head == NULL)
+        return;
+
+    touched();
+
+    //in a sorted sequence the element is equal to the one before it
+    //if it isn't greater than it
+    Node<Key, Info> *travel = head;
+    while(travel->next != NULL){
+        if(!less(travel->key, travel->info, travel->next->key, travel->next->info)){
+            Node<Key, Info> *temp = travel->next;
+            travel->next = temp->next;
+            destroyNode(temp);
+        }
+        else travel = travel->next;
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+Sequence<Key, Info> Sequence<Key, Info>::unionSorted(const Sequence<Key, Info> &sequence) const {
+
+    return unionSorted(sequence, KeyLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+Sequence<Key, Info> Sequence<Key, Info>::unionSorted(const Sequence<Key, Info> &sequence, Compare less) const {
+
+    Sequence<Key, Info> seq;
+    Node<Key, Info> *tail = NULL;
+
+    Node<Key, Info> *travel1 = this->head;
+    Node<Key, Info> *travel2 = sequence.head;
+    while(travel1 != NULL && travel2 != NULL){
+
+        if(less(travel2->key, travel2->info, travel1->key, travel1->info)){
+            seq.pushAfter(tail, travel2->key, travel2->info);
+            travel2 = travel2->next;
+        }
+        else if(less(travel1->key, travel1->info, travel2->key, travel2->info)){
+            seq.pushAfter(tail, travel1->key, travel1->info);
+            travel1 = travel1->next;
+        }
+        else{
+            seq.pushAfter(tail, travel1->key, travel1->info);
+            travel1 = travel1->next;
+            travel2 = travel2->next;
+        }
+    }
+
+    for(; travel1 != NULL; travel1 = travel1->next)
+        seq.pushAfter(tail, travel1->key, travel1->info);
+
+    for(; travel2 != NULL; travel2 = travel2->next)
+        seq.pushAfter(tail, travel2->key, travel2->info);
+
+    return seq;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+Sequence<Key, Info> Sequence<Key, Info>::intersectionSorted(const Sequence<Key, Info> &sequence) const {
+
+    return intersectionSorted(sequence, KeyLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+Sequence<Key, Info> Sequence<Key, Info>::intersectionSorted(const Sequence<Key, Info> &sequence,
+                                                            Compare less) const {
+
+    Sequence<Key, Info> seq;
+    Node<Key, Info> *tail = NULL;
+
+    Node<Key, Info> *travel1 = this->head;
+    Node<Key, Info> *travel2 = sequence.head;
+    while(travel1 != NULL && travel2 != NULL){
+
+        if(less(travel1->key, travel1->info, travel2->key, travel2->info)){
+            travel1 = travel1->next;
+        }
+        else if(less(travel2->key, travel2->info, travel1->key, travel1->info)){
+            travel2 = travel2->next;
+        }
+        else{
+            seq.pushAfter(tail, travel1->key, travel1->info);
+            travel1 = travel1->next;
+            travel2 = travel2->next;
+        }
+    }
+
+    return seq;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+Sequence<Key, Info> Sequence<Key, Info>::differenceSorted(const Sequence<Key, Info> &sequence) const {
+
+    return differenceSorted(sequence, KeyLess());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Compare>
+Sequence<Key, Info> Sequence<Key, Info>::differenceSorted(const Sequence<Key, Info> &sequence,
+                                                          Compare less) const {
+
+    Sequence<Key, Info> seq;
+    Node<Key, Info> *tail = NULL;
+
+    Node<Key, Info> *travel1 = this->head;
+    Node<Key, Info> *travel2 = sequence.head;
+    while(travel1 != NULL && travel2 != NULL){
+
+        if(less(travel1->key, travel1->info, travel2->key, travel2->info)){
+            seq.pushAfter(tail, travel1->key, travel1->info);
+            travel1 = travel1->next;
+        }
+        else if(less(travel2->key, travel2->info, travel1->key, travel1->info)){
+            travel2 = travel2->next;
+        }
+        else{
+            travel1 = travel1->next;
+            travel2 = travel2->next;
+        }
+    }
+
+    for(; travel1 != NULL; travel1 = travel1->next)
+        seq.pushAfter(tail, travel1->key, travel1->info);
+
+    return seq;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+int Sequence<Key, Info>::findBlock(const Node<Key, Info> *node) const {
+
+    //the last block starting at or before the node
+    std::uintptr_t address = (std::uintptr_t)node;
+    unsigned int low = 0, high = blocks.size();
+    while(low < high){
+        unsigned int middle = (low + high) / 2;
+        if((std::uintptr_t)blocks[middle]->memory <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if(low == 0)
+        return -1;
+
+    const Block *block = blocks[low - 1].get();
+    if(block->alive == 0 || address >= (std::uintptr_t)block->memory + block->capacity * sizeof(Node<Key, Info>))
+        return -1;
+
+    return low - 1;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::destroyNode(Node<Key, Info> *node) {
+
+    int index = blocks.empty() ? -1 : findBlock(node);
+    if(index < 0){
+        delete node;
+        return;
+    }
+
+    Block *block = blocks[index].get();
+    node->~Node<Key, Info>();
+
+    //only the sequence destroying the last node frees the memory
+    if(block->alive.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        ::operator delete(block->memory);
+        blocks.erase(blocks.begin() + index);
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::pruneBlocks() {
+
+    unsigned int kept = 0;
+    for(unsigned int i = 0; i < blocks.size(); i++){
+        if(blocks[i]->alive > 0)
+            blocks[kept++] = blocks[i];
+    }
+    blocks.resize(kept);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::adoptBlocks(const Sequence<Key, Info> &sequence) {
+
+    pruneBlocks();
+    for(unsigned int i = 0; i < sequence.blocks.size(); i++){
+        if(sequence.blocks[i]->alive > 0)
+            blocks.push_back(sequence.blocks[i]);
+    }
+
+    //a block can be shared already, if nodes of the sequence were moved here before
+    std::sort(blocks.begin(), blocks.end(), BlockLess());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::touched() {
+
+    revision++;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+std::shared_ptr<const typename Sequence<Key, Info>::SegmentCache>
+Sequence<Key, Info>::segmentBounds(unsigned int segments) const {
+
+    if(segments == 0) segments = 1;
+
+    {
+        std::lock_guard<std::mutex> lock(segmentLock);
+        if(segmentCache && segmentCache->revision == revision && segmentCache->segments == segments)
+            return segmentCache;
+    }
+
+    std::shared_ptr<SegmentCache> cut(new SegmentCache);
+    cut->revision = revision;
+    cut->segments = segments;
+
+    //storing every step-th node, when there are twice too many stored,
+    //every second one is dropped and the step doubles
+    unsigned int step = 1;
+    unsigned int index = 0;
+
+    for(const Node<Key, Info> *travel = head; travel != NULL; travel = travel->next, index++){
+        if(index % step != 0) continue;
+
+        if(cut->bounds.size() == 2 * segments){
+            unsigned int kept = 0;
+            for(unsigned int i = 0; i < cut->bounds.size(); i += 2)
+                cut->bounds[kept++] = cut->bounds[i];
+            cut->bounds.resize(kept);
+
+            step *= 2;
+            if(index % step != 0) continue;
+        }
+
+        cut->bounds.push_back(travel);
+    }
+
+    cut->bounds.push_back(NULL);
+
+    std::lock_guard<std::mutex> lock(segmentLock);
+    segmentCache = cut;
+    return cut;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::edited(unsigned int count) {
+
+    touched();
+    edits += count;
+
+    if(compactThreshold > 0 && edits >= compactThreshold)
+        compact();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+std::size_t Sequence<Key, Info>::allocationSize(std::size_t bytes) {
+
+    std::size_t size = (bytes + sizeof(std::size_t) + 15) / 16 * 16;
+    return size < 32 ? 32 : size;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::measure(std::size_t &bytes, double &fragmentation) const {
+
+    bytes = 0;
+    fragmentation = 0;
+    if(head == NULL)
+        return;
+
+    //every block is counted once, as a whole (with places of removed nodes)
+    std::vector<bool> counted(blocks.size(), false);
+    unsigned int links = 0, scattered = 0;
+
+    for(Node<Key, Info> *travel = head; travel != NULL; travel = travel->next){
+
+        int index = blocks.empty() ? -1 : findBlock(travel);
+        if(index < 0){
+            bytes += allocationSize(sizeof(Node<Key, Info>));
+        }
+        else if(!counted[index]){
+            counted[index] = true;
+            bytes += allocationSize(sizeof(Block));
+            bytes += allocationSize(blocks[index]->capacity * sizeof(Node<Key, Info>));
+        }
+
+        if(travel->next != NULL){
+            links++;
+            if(travel->next != travel + 1)
+                scattered++;
+        }
+    }
+
+    if(links > 0)
+        fragmentation = (double)scattered / links;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::CompactReport Sequence<Key, Info>::compact() {
+
+    edits = 0;
+    touched();
+
+    CompactReport report = CompactReport();
+    report.nodes = length();
+    measure(report.bytesBefore, report.fragmentationBefore);
+
+    report.bytesAfter = report.bytesBefore;
+    report.fragmentationAfter = report.fragmentationBefore;
+
+    if(head == NULL){
+        compactReport = report;
+        return report;
+    }
+
+    std::shared_ptr<Block> block;
+    Node<Key, Info> *nodes;
+    try {
+        block = std::shared_ptr<Block>(new Block());
+        block->memory = ::operator new(report.nodes * sizeof(Node<Key, Info>));
+        pruneBlocks();
+        blocks.reserve(blocks.size() + 1);
+    }
+    catch (const std::bad_alloc &) {
+        std::cerr << "Failed allocating memory for the compacted nodes" << std::endl;
+        if(block)
+            ::operator delete(block->memory);
+        compactReport = report;
+        return report;
+    }
+
+    block->capacity = report.nodes;
+    nodes = static_cast<Node<Key, Info>*>(block->memory);
+
+    //moving key and info of the nodes into the block, in the order of the sequence
+    unsigned int moved = 0;
+    Node<Key, Info> *travel = head;
+    try {
+        for(; travel != NULL; travel = travel->next){
+            Node<Key, Info> *newNode = new (&nodes[moved]) Node<Key, Info>(std::move(travel->key),
+                                                                           std::move(travel->info));
+            if(moved > 0)
+                nodes[moved - 1].next = newNode;
+            moved++;
+        }
+    }
+    catch (...) {
+        //giving key and info back to the old nodes, the sequence is left as it was
+        travel = head;
+        for(unsigned int i = 0; i < moved; i++, travel = travel->next){
+            travel->key = std::move(nodes[i].key);
+            travel->info = std::move(nodes[i].info);
+            nodes[i].~Node<Key, Info>();
+        }
+        ::operator delete(block->memory);
+        compactReport = report;
+
+        //failed allocation is reported like everywhere else, other exceptions go to the caller
+        try {
+            throw;
+        }
+        catch (const std::bad_alloc &) {
+            std::cerr << "Failed allocating memory for the compacted nodes" << std::endl;
+            return report;
+        }
+    }
+
+    //freeing the old nodes
+    travel = head;
+    while(travel != NULL){
+        Node<Key, Info> *temp = travel;
+        travel = travel->next;
+        destroyNode(temp);
+    }
+    head = nodes;
+
+    block->alive.store(moved, std::memory_order_relaxed);
+    blocks.push_back(block);
+    std::sort(blocks.begin(), blocks.end(), BlockLess());
+
+    //every node is in the new block now, one after another
+    report.bytesAfter = allocationSize(sizeof(Block)) + allocationSize(report.nodes * sizeof(Node<Key, Info>));
+    report.fragmentationAfter = 0;
+    report.bytesReclaimed = report.bytesBefore > report.bytesAfter ? report.bytesBefore - report.bytesAfter : 0;
+
+    compactReport = report;
+    return report;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void Sequence<Key, Info>::setAutoCompact(unsigned int count) {
+
+    compactThreshold = count;
+    edits = 0;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename Sequence<Key, Info>::CompactReport Sequence<Key, Info>::lastCompact() const {
+
+    return compactReport;
+}
+
+//--------------------------------------------------------------------------
+
 
 #endif //SEQUENCE_SEQUENCE_H
@@ -0,0 +1,662 @@
+/***************************************************************************
+* SharedSequence is a Sequence shared between many reader threads and
+* writers. Readers take a snapshot - an immutable version of the sequence -
+* and walk it without any lock, while a writer works on its own copy of
+* the current version and then publishes it atomically. Snapshots taken
+* before are left untouched.
+*
+* Taking and releasing a snapshot is lock-free. The address of the current
+* version is kept in one atomic word, together with the number of snapshots
+* being taken of it at the moment (split reference counting): a reader
+* takes the version with a single atomic increment of the word, and then
+* moves its reference to the counter of the version. Readers never free a
+* version - the one releasing the last snapshot of an old version only
+* pushes it on the list of released versions, and the next writer (or
+* reclaim()) frees them.
+*
+* Versions share their nodes. Writers are serialized with a mutex, and a
+* single edit copies only the nodes before the edited position, linking
+* the copies to the unchanged rest of the current version, so pushFront
+* takes O(1), insertAfter, insertBefore and remove O(position), and only
+* pushBack O(n) time and memory. Every node counts the links to it (heads
+* of versions and nodes before it), and it's freed with the last version
+* linking to it. update(...) and apply(...) edit a whole working copy and
+* then share it as the new version, so many edits should be grouped there.
+*
+* The address of a version has to fit in the low 48 bits of the word (as
+* every user space address does on x86-64 and AArch64), and up to 65535
+* readers can be in the middle of taking a snapshot of the same version.
+*
+* Nomenclature:
+ * version  -> sequence published by a writer, never modified afterwards
+ * link     -> pointer to a shared node, from the head of a version or a node
+ * snapshot -> reader's reference to a version
+ * released -> version without any snapshot, waiting to be freed by a writer
+****************************************************************************/
+    /* EXAMPLE:
+     *  SharedSequence<int, int> shared;
+     *  // reader thread
+     *  SharedSequence<int, int>::Snapshot snapshot = shared.snapshot();
+     *  for (auto element : *snapshot) ...
+     *  // writer thread
+     *  shared.update([](Sequence<int, int> &sequence){ sequence.pushFront(1, 2); });
+     */
+
+#ifndef SEQUENCE_SHARED_H
+#define SEQUENCE_SHARED_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include "sequence.h"
+#include "batch.h"
+
+
+template <typename Key, typename Info>
+class SharedSequence {
+
+private:
+    struct Released {
+        std::atomic<std::uintptr_t> head;   // last released version, CLOSED after destruction
+    };
+
+    typedef typename Sequence<Key, Info>::template Node<Key, Info> SeqNode;
+
+    struct SharedNode : SeqNode {
+        std::atomic<unsigned int> links;    // heads of versions and nodes linking to it
+
+        //constructors for SharedNode, linked once
+        SharedNode(const Key &k, const Info &i) : SeqNode(k, i) { links.store(1, std::memory_order_relaxed); }
+        SharedNode(Key &&k, Info &&i) : SeqNode(std::move(k), std::move(i)) { links.store(1, std::memory_order_relaxed); }
+    };
+    // node of the versions, its next isn't changed once it's published
+
+    struct Version {
+        Sequence<Key, Info> sequence;       // made of shared nodes, see drop(...)
+        std::atomic<long> references;       // snapshots, and 1 while it's the current version
+        Version *nextReleased;
+        std::shared_ptr<Released> released; // list to push the version on, when it's released
+
+        //constructor for Version
+        explicit Version(const std::shared_ptr<Released> &list) {
+            references.store(1);
+            nextReleased = NULL;
+            released = list;
+        }
+
+        //destructor for Version, the nodes are freed here and not by the
+        //sequence, as other versions can link to them
+        ~Version() {
+            SeqNode *chain = sequence.head;
+            sequence.head = NULL;
+            drop(chain);
+        }
+    };
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "SharedSequence needs lock-free 64-bit atomics");
+
+    static const unsigned long long ADDRESS_MASK = (1ULL << 48) - 1;
+    static const unsigned long long ONE_READER = 1ULL << 48;
+    static const std::uintptr_t CLOSED = 1;
+
+    mutable std::atomic<unsigned long long> current;    // address of the current version (low 48 bits)
+                                                        // and snapshots being taken of it (high 16 bits)
+
+    std::shared_ptr<Released> released;                 // shared with the versions, which can outlive this
+
+    std::mutex writers;  // writers are serialized, readers never take it
+
+    static Version *address(unsigned long long word);
+    // RETURNS: version stored in the word
+
+    Version *newVersion() const;
+    // RETURNS: new version with an empty sequence
+    // THROWS: std::string if its address doesn't fit in 48 bits
+
+    Version *currentVersion() const;
+    // RETURNS: the current version, used by writers (as only they replace it)
+
+    static void drop(SeqNode *node);
+    // drops a link to the node, and frees the nodes left without any link
+
+    SeqNode *find(const Key &key, const Info &info, int occurrence) const;
+    // RETURNS: given occurrence of the element in the current version,
+    //          NULL if there's no such one (with the message of Sequence)
+
+    bool publishPath(const SeqNode *until, const Key *newKey, const Info *newInfo, SeqNode *rest);
+    // publishes a new version made of copies of the current nodes before
+    // until, the new element (if newKey isn't NULL) and then the nodes from
+    // rest on, shared with the current version
+    // RETURNS:
+    //    true, if the version was published
+    //    false, if the new nodes couldn't be allocated (nothing is published)
+    // THROWS: same as newVersion(), and exceptions of Key and Info copies
+
+    Version *share(const Sequence<Key, Info> &sequence) const;
+    Version *share(Sequence<Key, Info> &&sequence) const;
+    // RETURNS: new version with shared copies of the nodes of the sequence
+    //          (moved out of it, if it's an rvalue)
+    // THROWS: same as newVersion(), std::bad_alloc, and exceptions of Key and
+    //         Info copies (nothing is leaked then)
+
+    void publish(Version *version);
+    // makes the version current, turns the snapshots being taken of the old
+    // one into its references, and frees the released versions
+
+    void freeReleased();
+    // frees every version on the released list, used by writers
+
+    static void release(Version *version);
+    // drops a reference of the version, pushing it on the released list if
+    // it was the last one (or freeing it, if the SharedSequence is destroyed)
+
+public:
+
+    class Snapshot {
+    // reference to a version, copying and destroying it is lock-free
+
+        friend class SharedSequence<Key, Info>;
+
+        Version *version;
+
+        explicit Snapshot(Version *taken) { version = taken; }
+
+    public:
+        Snapshot() { version = NULL; }
+        Snapshot(const Snapshot &snapshot) {
+            version = snapshot.version;
+            if(version != NULL)
+                version->references.fetch_add(1, std::memory_order_relaxed);
+        }
+        Snapshot(Snapshot &&snapshot) { version = snapshot.version; snapshot.version = NULL; }
+        ~Snapshot() { if(version != NULL) release(version); }
+
+        Snapshot &operator=(Snapshot snapshot) { std::swap(version, snapshot.version); return *this; }
+
+        const Sequence<Key, Info> &operator*() const { return version->sequence; }
+        const Sequence<Key, Info> *operator->() const { return &version->sequence; }
+        const Sequence<Key, Info> *get() const { return version == NULL ? NULL : &version->sequence; }
+
+        explicit operator bool() const { return version != NULL; }
+    };
+
+
+    /***************************************************************************
+    *  MEMBER FUNCTIONS
+    ****************************************************************************/
+
+    // default constructor
+    SharedSequence();
+
+    // constructor publishing the copy of the given sequence
+    explicit SharedSequence(const Sequence<Key, Info> &sequence);
+
+    // destructor, snapshots taken before stay valid (and the last one of
+    // a version frees it then)
+    ~SharedSequence();
+
+    SharedSequence(const SharedSequence<Key, Info> &) = delete;
+    SharedSequence<Key, Info> &operator=(const SharedSequence<Key, Info> &) = delete;
+
+
+/***************************************************************************
+*  READERS
+****************************************************************************/
+
+    Snapshot snapshot() const;
+    // RETURNS: the current version, which stays valid and unchanged as long as
+    //          the snapshot is kept, whatever the writers do
+
+/***************************************************************************
+*  WRITERS
+****************************************************************************/
+
+    template <typename Function>
+    void update(Function function);
+    // calls function(sequence) on a copy of the current version and publishes it
+    // PARAMETERS: function modifying the given Sequence<Key, Info> &
+    // THROWS: what the function throws, and std::bad_alloc if the new version
+    //         can't be allocated (nothing is published then)
+
+    bool pushFront(const Key &newKey, const Info &newInfo);
+    bool pushBack(const Key &newKey, const Info &newInfo);
+    bool insertAfter(const Key &key, const Info &info, const Key &newKey, const Info &newInfo, int occurrence = 1);
+    bool insertBefore(const Key &key, const Info &info, const Key &newKey, const Info &newInfo, int occurrence = 1);
+    bool remove(const Key &key, const Info &info, int occurrence = 1);
+    // same as in Sequence, every call publishes a new version sharing the
+    // nodes after the edited position with the current one
+    // RETURNS:
+    //    true, if the modification was successful
+    //    false, if it wasn't (no version is published then)
+
+    unsigned int apply(SequenceBatch<Key, Info> &batch);
+    // applies every command of the batch on a single working copy and publishes it
+    // RETURNS: number of commands that were successful
+
+    void clear();
+    // publishes an empty sequence
+
+    void reclaim();
+    // frees the versions released since the last write, without writing
+
+};
+
+
+/***********************************************************************
+*   IMPLEMENTATION
+************************************************************************/
+
+
+
+template<typename Key, typename Info>
+SharedSequence<Key, Info>::SharedSequence() {
+
+    current.store(0);
+    released = std::shared_ptr<Released>(new Released());
+    released->head.store(0);
+
+    publish(newVersion());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+SharedSequence<Key, Info>::SharedSequence(const Sequence<Key, Info> &sequence) {
+
+    current.store(0);
+    released = std::shared_ptr<Released>(new Released());
+    released->head.store(0);
+
+    publish(share(sequence));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+SharedSequence<Key, Info>::~SharedSequence() {
+
+    //dropping the reference of the current version
+    publish(NULL);
+
+    //from now on the last snapshot of a version frees it by itself
+    std::uintptr_t list = released->head.exchange(CLOSED, std::memory_order_acquire);
+    while(list != 0){
+        Version *temp = (Version*)list;
+        list = (std::uintptr_t)temp->nextReleased;
+        delete temp;
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::Version *SharedSequence<Key, Info>::address(unsigned long long word) {
+
+    return (Version*)(std::uintptr_t)(word & ADDRESS_MASK);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::Version *SharedSequence<Key, Info>::newVersion() const {
+
+    Version *version = new Version(released);
+
+    if(((unsigned long long)(std::uintptr_t)version & ~ADDRESS_MASK) != 0){
+        delete version;
+        std::string addressException = "Version address doesn't fit in 48 bits.";
+        throw std::string(addressException);
+    }
+
+    return version;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::Version *SharedSequence<Key, Info>::currentVersion() const {
+
+    //only writers change the current version, and they're serialized
+    return address(current.load(std::memory_order_acquire));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SharedSequence<Key, Info>::drop(SeqNode *node) {
+
+    //versions sharing the nodes can be freed by different threads (readers
+    //free them once the SharedSequence is destroyed), so only the one
+    //dropping the last link frees the node, and then drops its next
+    while(node != NULL){
+        SharedNode *temp = static_cast<SharedNode*>(node);
+        if(temp->links.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        node = temp->next;
+        delete temp;
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::SeqNode *SharedSequence<Key, Info>::find(const Key &key, const Info &info,
+                                                                             int occurrence) const {
+
+    if(occurrence < 1)
+        occurrence = 1;
+
+    int seen = 0;
+    SeqNode *travel = currentVersion()->sequence.head;
+    while(travel != NULL){
+        if(travel->key == key && travel->info == info){
+            seen++;
+            if(seen == occurrence)
+                return travel;
+        }
+        travel = travel->next;
+    }
+
+    if(seen == 0)
+        std::cerr << "Couldn't find element: {" << key << ", " << info << "}" << std::endl;
+    else
+        std::cerr << "Occurrence index out of bounds (" << occurrence << ")." << std::endl;
+
+    return NULL;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SharedSequence<Key, Info>::publishPath(const SeqNode *until, const Key *newKey, const Info *newInfo,
+                                            SeqNode *rest) {
+
+    Version *version = newVersion();
+
+    //the new nodes are linked one after another, so deleting the version
+    //frees the ones made so far, and rest gets its link once they're all made
+    SeqNode **link = &version->sequence.head;
+    try {
+        for(const SeqNode *travel = currentVersion()->sequence.head; travel != until; travel = travel->next){
+            *link = new SharedNode(travel->key, travel->info);
+            link = &(*link)->next;
+        }
+        if(newKey != NULL){
+            *link = new SharedNode(*newKey, *newInfo);
+            link = &(*link)->next;
+        }
+    }
+    catch (const std::bad_alloc &) {
+        std::cerr << "Failed allocating memory for the new node" << std::endl;
+        delete version;
+        return false;
+    }
+    catch (...) {
+        delete version;
+        throw;
+    }
+
+    if(rest != NULL)
+        static_cast<SharedNode*>(rest)->links.fetch_add(1, std::memory_order_relaxed);
+    *link = rest;
+
+    publish(version);
+    return true;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::Version *SharedSequence<Key, Info>::share(const Sequence<Key, Info> &sequence) const {
+
+    Version *version = newVersion();
+
+    SeqNode **link = &version->sequence.head;
+    try {
+        for(const SeqNode *travel = sequence.head; travel != NULL; travel = travel->next){
+            *link = new SharedNode(travel->key, travel->info);
+            link = &(*link)->next;
+        }
+    }
+    catch (...) {
+        delete version;
+        throw;
+    }
+
+    return version;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::Version *SharedSequence<Key, Info>::share(Sequence<Key, Info> &&sequence) const {
+
+    Version *version = newVersion();
+
+    SeqNode **link = &version->sequence.head;
+    try {
+        for(SeqNode *travel = sequence.head; travel != NULL; travel = travel->next){
+            *link = new SharedNode(std::move(travel->key), std::move(travel->info));
+            link = &(*link)->next;
+        }
+    }
+    catch (...) {
+        delete version;
+        throw;
+    }
+
+    return version;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SharedSequence<Key, Info>::publish(Version *version) {
+
+    unsigned long long old = current.exchange((unsigned long long)(std::uintptr_t)version,
+                                              std::memory_order_acq_rel);
+
+    Version *previous = address(old);
+    if(previous != NULL){
+        //every snapshot being taken of the old version becomes its reference,
+        //and the reference of the current version is dropped
+        long taken = (long)(old >> 48);
+        if(previous->references.fetch_add(taken - 1, std::memory_order_acq_rel) == 1 - taken)
+            delete previous;
+    }
+
+    freeReleased();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SharedSequence<Key, Info>::freeReleased() {
+
+    std::uintptr_t list = released->head.exchange(0, std::memory_order_acquire);
+    while(list != 0){
+        Version *temp = (Version*)list;
+        list = (std::uintptr_t)temp->nextReleased;
+        delete temp;
+    }
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SharedSequence<Key, Info>::release(Version *version) {
+
+    if(version->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    Released *list = version->released.get();
+    std::uintptr_t head = list->head.load(std::memory_order_relaxed);
+    do {
+        if(head == CLOSED){
+            delete version;
+            return;
+        }
+        version->nextReleased = (Version*)head;
+    } while(!list->head.compare_exchange_weak(head, (std::uintptr_t)version,
+                                              std::memory_order_release, std::memory_order_relaxed));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename SharedSequence<Key, Info>::Snapshot SharedSequence<Key, Info>::snapshot() const {
+
+    unsigned long long taken = current.fetch_add(ONE_READER, std::memory_order_acquire);
+    Version *version = address(taken);
+    version->references.fetch_add(1, std::memory_order_relaxed);
+
+    //giving the count back to the word, unless a writer has replaced the
+    //version and already turned it into a reference (see publish); release,
+    //so the writer replacing the version afterwards sees the increment above
+    unsigned long long expected = taken + ONE_READER;
+    while(!current.compare_exchange_weak(expected, expected - ONE_READER,
+                                         std::memory_order_release, std::memory_order_relaxed)){
+        if(address(expected) != version){
+            version->references.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    return Snapshot(version);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+template<typename Function>
+void SharedSequence<Key, Info>::update(Function function) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    Sequence<Key, Info> working(currentVersion()->sequence);
+    function(working);
+
+    publish(share(std::move(working)));
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SharedSequence<Key, Info>::pushFront(const Key &newKey, const Info &newInfo) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    //nothing is copied, the new node links to the current head
+    SeqNode *head = currentVersion()->sequence.head;
+    return publishPath(head, &newKey, &newInfo, head);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SharedSequence<Key, Info>::pushBack(const Key &newKey, const Info &newInfo) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    //every node is copied, as the last one links to the new one
+    return publishPath(NULL, &newKey, &newInfo, NULL);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SharedSequence<Key, Info>::insertAfter(const Key &key, const Info &info, const Key &newKey,
+                                            const Info &newInfo, int occurrence) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    SeqNode *found = find(key, info, occurrence);
+    if(found == NULL)
+        return false;
+
+    return publishPath(found->next, &newKey, &newInfo, found->next);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SharedSequence<Key, Info>::insertBefore(const Key &key, const Info &info, const Key &newKey,
+                                             const Info &newInfo, int occurrence) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    SeqNode *found = find(key, info, occurrence);
+    if(found == NULL)
+        return false;
+
+    return publishPath(found, &newKey, &newInfo, found);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool SharedSequence<Key, Info>::remove(const Key &key, const Info &info, int occurrence) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    SeqNode *found = find(key, info, occurrence);
+    if(found == NULL)
+        return false;
+
+    return publishPath(found, NULL, NULL, found->next);
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+unsigned int SharedSequence<Key, Info>::apply(SequenceBatch<Key, Info> &batch) {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    Sequence<Key, Info> working(currentVersion()->sequence);
+    unsigned int successful = batch.apply(working);
+    if(successful == 0)
+        return 0;
+
+    Version *version;
+    try {
+        version = share(std::move(working));
+    }
+    catch (const std::bad_alloc &) {
+        std::cerr << "Failed allocating memory for the new nodes" << std::endl;
+        return 0;
+    }
+
+    publish(version);
+    return successful;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SharedSequence<Key, Info>::clear() {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    publish(newVersion());
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void SharedSequence<Key, Info>::reclaim() {
+
+    std::lock_guard<std::mutex> lock(writers);
+
+    freeReleased();
+}
+
+//--------------------------------------------------------------------------
+
+
+#endif //SEQUENCE_SHARED_H
@@ -1,4 +1,3 @@
-
 //
 // Created by Ernest Pokropek
 //
@@ -19,68 +18,304 @@
      *  s3: 3 4 10 20 30 5 6 40 50 60 7 8 70 80 90 100
      */
 
+    // shuffleView(...) takes the same parameters and does the same checks, but
+    // returns a ShuffleView, which walks S1 and S2 only while it's iterated
+    // (nothing is allocated, and breaking the loop stops the walk); temporary
+    // sequences are moved into the view, so they live as long as it does
+    /* EXAMPLE:
+     *  for (auto element : shuffleView(s1, 2, 2, s2, 0, 3, 4))
+     *      std::cout << element.first << " ";
+     *  Sequence<int, int> s3 = shuffleView(s1, 2, 2, s2, 0, 3, 4);
+     */
+
 #ifndef SEQUENCE_SHUFFLE_H
 #define SEQUENCE_SHUFFLE_H
 
+#include <memory>
+#include <string>
+#include <utility>
 #include "sequence.h"
 
 
+template <typename Key, typename Info>
+class ShuffleView {
+
+private:
+    typedef typename Sequence<Key, Info>::const_iterator SeqIterator;
+
+    SeqIterator begin1, begin2;
+    unsigned int length1, length2;
+    unsigned int count;
+
+    std::shared_ptr<const Sequence<Key, Info> > owned1, owned2;    // temporary sources, empty otherwise
+
+public:
+
+    class iterator {
+    // walks both sequences with one cursor for each of them
+
+        friend class ShuffleView<Key, Info>;
+
+        SeqIterator travel1, travel2;
+        unsigned int length1, length2;
+        unsigned int count;
+
+        unsigned int cycle;    // number of finished shuffle cycles
+        unsigned int taken;    // elements taken in the current block
+        bool second;           // true, if the current block is taken from S2
+
+        void settle();
+        // moves to the next block if the current one is finished,
+        // cycle == count marks the end
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Key, Info> value_type;
+        typedef std::pair<const Key&, const Info&> reference;
+        typedef void pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() { length1 = length2 = count = cycle = taken = 0; second = false; }
+
+        reference operator*() const { return second ? *travel2 : *travel1; }
+
+        iterator &operator++();
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator &other) const;
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+    };
+
+    ShuffleView(const Sequence<Key, Info> &S1, unsigned int start1, unsigned int len1,
+                const Sequence<Key, Info> &S2, unsigned int start2, unsigned int len2,
+                unsigned int cycles,
+                const std::shared_ptr<const Sequence<Key, Info> > &keep1 = std::shared_ptr<const Sequence<Key, Info> >(),
+                const std::shared_ptr<const Sequence<Key, Info> > &keep2 = std::shared_ptr<const Sequence<Key, Info> >());
+    // PARAMETERS: same as in shuffle(...), and owners of S1 and S2 to keep
+    //             as long as the view (used for temporaries)
+    // THROWS: lengthException in case of wrong input (start, count ount of bounds)
+
+    iterator begin() const;
+    // RETURNS: iterator at the first element of the shuffle
+
+    iterator end() const;
+    // RETURNS: iterator past the last element of the shuffle
+
+    Sequence<Key, Info> toSequence() const;
+    operator Sequence<Key, Info>() const;
+    // RETURNS: a new, shuffled sequence
+
+};
+
+
+template <typename Key, typename Info>
+ShuffleView<Key, Info> shuffleView(const Sequence<Key, Info> &S1, unsigned int start1, unsigned int length1,
+                                   const Sequence<Key, Info> &S2, unsigned int start2, unsigned int length2,
+                                   unsigned int count){
+
+    return ShuffleView<Key, Info>(S1, start1, length1, S2, start2, length2, count);
+}
+
+template <typename Key, typename Info>
+ShuffleView<Key, Info> shuffleView(Sequence<Key, Info> &&S1, unsigned int start1, unsigned int length1,
+                                   const Sequence<Key, Info> &S2, unsigned int start2, unsigned int length2,
+                                   unsigned int count){
+
+    std::shared_ptr<const Sequence<Key, Info> > owned1(new Sequence<Key, Info>(std::move(S1)));
+    return ShuffleView<Key, Info>(*owned1, start1, length1, S2, start2, length2, count, owned1);
+}
+
+template <typename Key, typename Info>
+ShuffleView<Key, Info> shuffleView(const Sequence<Key, Info> &S1, unsigned int start1, unsigned int length1,
+                                   Sequence<Key, Info> &&S2, unsigned int start2, unsigned int length2,
+                                   unsigned int count){
+
+    std::shared_ptr<const Sequence<Key, Info> > owned2(new Sequence<Key, Info>(std::move(S2)));
+    return ShuffleView<Key, Info>(S1, start1, length1, *owned2, start2, length2, count,
+                                  std::shared_ptr<const Sequence<Key, Info> >(), owned2);
+}
+
+template <typename Key, typename Info>
+ShuffleView<Key, Info> shuffleView(Sequence<Key, Info> &&S1, unsigned int start1, unsigned int length1,
+                                   Sequence<Key, Info> &&S2, unsigned int start2, unsigned int length2,
+                                   unsigned int count){
+
+    std::shared_ptr<const Sequence<Key, Info> > owned1(new Sequence<Key, Info>(std::move(S1)));
+    std::shared_ptr<const Sequence<Key, Info> > owned2(new Sequence<Key, Info>(std::move(S2)));
+    return ShuffleView<Key, Info>(*owned1, start1, length1, *owned2, start2, length2, count, owned1, owned2);
+}
+// temporary sequences are moved into the view (the same one can't be passed twice)
+
+
 template <typename Key, typename Info>
 Sequence<Key, Info> shuffle(const Sequence<Key, Info> &S1, unsigned int start1, unsigned int length1,
                             const Sequence<Key, Info> &S2, unsigned int start2, unsigned int length2,
                             unsigned int count){
 
+    return shuffleView(S1, start1, length1, S2, start2, length2, count).toSequence();
+}
+
+
+/***********************************************************************
+*   IMPLEMENTATION
+************************************************************************/
 
-    if (start1 > length1 || start2 > length2 || S1.length() < start1 || S2.length() < start2) {
+
+
+template<typename Key, typename Info>
+ShuffleView<Key, Info>::ShuffleView(const Sequence<Key, Info> &S1, unsigned int start1, unsigned int len1,
+                                    const Sequence<Key, Info> &S2, unsigned int start2, unsigned int len2,
+                                    unsigned int cycles,
+                                    const std::shared_ptr<const Sequence<Key, Info> > &keep1,
+                                    const std::shared_ptr<const Sequence<Key, Info> > &keep2){
+
+    //size1 and size2 not to induce length() function every check
+    unsigned int size1 = S1.length(), size2 = S2.length();
+
+    if (start1 > len1 || start2 > len2 || size1 < start1 || size2 < start2) {
         std::string lengthException = "Start index out of bounds.";
         throw std::string(lengthException);
     }
 
-    if (S1.length() < length1 || S2.length() < length2) {
+    if (size1 < len1 || size2 < len2) {
         std::string lengthException = "Length index out of bounds.";
         throw std::string(lengthException);
     }
 
-    if (count == 0) {
+    if (cycles == 0) {
         std::string lengthException = "Count can't be equal to 0.";
         throw std::string(lengthException);
     }
 
     //correct input
 
+    owned1 = keep1;
+    owned2 = keep2;
+
+    begin1 = S1.begin();
+    for(unsigned int i = 0; i < start1; i++)
+        ++begin1;
+
+    begin2 = S2.begin();
+    for(unsigned int i = 0; i < start2; i++)
+        ++begin2;
+
+    length1 = len1;
+    length2 = len2;
+    count = cycles;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename ShuffleView<Key, Info>::iterator ShuffleView<Key, Info>::begin() const {
+
+    iterator it;
+    it.travel1 = begin1;
+    it.travel2 = begin2;
+    it.length1 = length1;
+    it.length2 = length2;
+    it.count = count;
+    it.settle();
+
+    return it;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename ShuffleView<Key, Info>::iterator ShuffleView<Key, Info>::end() const {
+
+    iterator it;
+    it.cycle = count;
+
+    return it;
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+Sequence<Key, Info> ShuffleView<Key, Info>::toSequence() const {
+
     //sequence to return
     Sequence<Key, Info> outputSequence;
 
-    //creating index1,2 to clarify code, and
-    //size1 and size2 not to induce length() function
-    //every iteration
-    unsigned int index1 = start1, index2 = start2;
-    unsigned int size1 = S1.length(), size2 = S2.length();
+    typename Sequence<Key, Info>::Appender out = outputSequence.appender();
+    for(iterator it = begin(); it != end(); ++it)
+        out = *it;
+
+    return outputSequence;
+}
 
-    //creating key and info to store values from getNode(...);
-    Key aKey;
-    Info aInfo;
+//--------------------------------------------------------------------------
 
-    //number of shuffles loop
-    for(int countNum = 0; countNum < count; countNum++){
-        //put elements into sequence until there are no more to put
-        //or the number of given length was fulfilled
-        for(int i = 0; index1 < size1 && i < length1; i++){
-            if(S1.getNode(index1, aKey, aInfo))
-                outputSequence.pushBack(aKey, aInfo);
-            index1++;
+template<typename Key, typename Info>
+ShuffleView<Key, Info>::operator Sequence<Key, Info>() const {
+
+    return toSequence();
+}
+
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+void ShuffleView<Key, Info>::iterator::settle() {
+
+    SeqIterator last;
+
+    while(cycle < count){
+
+        //both sequences ran out of elements, no need to finish the cycles
+        if(travel1 == last && travel2 == last){
+            cycle = count;
+            return;
         }
-        //put elements into sequence until there are no more to put
+
+        //put elements until there are no more to put
         //or the number of given length was fulfilled
-        for(int i = 0; index2 < size2 && i < length2; i++){
-            if(S2.getNode(index2, aKey, aInfo))
-                outputSequence.pushBack(aKey, aInfo);
-            index2++;
+        if(!second){
+            if(travel1 != last && taken < length1)
+                return;
+            second = true;
+        }
+        else{
+            if(travel2 != last && taken < length2)
+                return;
+            second = false;
+            cycle++;
         }
+        taken = 0;
     }
+}
 
-    return outputSequence;
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+typename ShuffleView<Key, Info>::iterator &ShuffleView<Key, Info>::iterator::operator++() {
+
+    if(second)
+        ++travel2;
+    else
+        ++travel1;
+
+    taken++;
+    settle();
+
+    return *this;
 }
 
+//--------------------------------------------------------------------------
+
+template<typename Key, typename Info>
+bool ShuffleView<Key, Info>::iterator::operator==(const iterator &other) const {
+
+    //every finished iterator is equal to end()
+    if(cycle >= count || other.cycle >= other.count)
+        return cycle >= count && other.cycle >= other.count;
+
+    return travel1 == other.travel1 && travel2 == other.travel2 && second == other.second && taken == other.taken;
+}
+
+//--------------------------------------------------------------------------
+
 
 #endif //SEQUENCE_SHUFFLE_H
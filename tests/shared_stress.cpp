@@ -0,0 +1,153 @@
+/***************************************************************************
+* Stress test of SharedSequence: many readers take, copy, keep and release
+* snapshots, while a single writer publishes new versions and reclaims the
+* released ones. Every version the writer publishes keeps the keys sorted
+* and info equal to twice the key, so a reader seeing anything else (or a
+* snapshot changing while it's kept) found a freed or half built version.
+*
+* Build and run (best with -fsanitize=thread or -fsanitize=address):
+*   g++ -std=c++11 -O1 -g -pthread -fsanitize=thread tests/shared_stress.cpp -o shared_stress
+*   ./shared_stress
+****************************************************************************/
+
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "../shared.h"
+
+
+typedef SharedSequence<int, int> Shared;
+
+static const int READERS = 6;
+static const int WRITES = 20000;
+static const unsigned int KEPT = 8;    // snapshots kept by every reader at once
+
+static void check(bool condition, const char *message){
+
+    if(!condition){
+        std::fprintf(stderr, "FAILED: %s\n", message);
+        std::abort();
+    }
+}
+
+//--------------------------------------------------------------------------
+
+static unsigned long checksum(const Sequence<int, int> &sequence){
+
+    //checks the invariant of every published version on the way
+    unsigned long sum = 0;
+    int previous = INT_MIN;
+    for(Sequence<int, int>::const_iterator travel = sequence.begin(); travel != sequence.end(); ++travel){
+        check(travel.key() > previous, "keys of a version aren't sorted");
+        check(travel.info() == 2 * travel.key(), "info of a version doesn't match its key");
+        previous = travel.key();
+        sum = sum * 31 + travel.key();
+    }
+    return sum;
+}
+
+//--------------------------------------------------------------------------
+
+static void reader(const Shared &shared, const std::atomic<bool> &stop, std::atomic<long> &taken){
+
+    std::vector<Shared::Snapshot> kept;
+    std::vector<unsigned long> sums;
+    unsigned int turn = 0;
+
+    while(!stop.load()){
+        Shared::Snapshot snapshot = shared.snapshot();
+        check(bool(snapshot), "snapshot is empty");
+
+        unsigned long sum = checksum(*snapshot);
+        check(snapshot->isEmpty() == (snapshot->length() == 0), "isEmpty doesn't match length");
+        if(!snapshot->isEmpty())
+            check(snapshot->exists(snapshot->begin().key(), 2 * snapshot->begin().key()), "first element doesn't exist");
+
+        //copies and moves of the snapshot, released in a different order
+        Shared::Snapshot copy = snapshot;
+        Shared::Snapshot moved(std::move(copy));
+        check(!copy && moved.get() == snapshot.get(), "copied snapshot differs");
+
+        if(kept.size() < KEPT){
+            kept.push_back(moved);
+            sums.push_back(sum);
+        }
+        else{
+            //a kept snapshot must be unchanged, whatever the writer did
+            unsigned int i = turn++ % KEPT;
+            check(checksum(*kept[i]) == sums[i], "kept snapshot has changed");
+            kept[i] = moved;
+            sums[i] = sum;
+        }
+
+        taken++;
+    }
+
+    for(unsigned int i = 0; i < kept.size(); i++)
+        check(checksum(*kept[i]) == sums[i], "kept snapshot has changed");
+}
+
+//--------------------------------------------------------------------------
+
+int main(){
+
+    Shared shared;
+    for(int i = 0; i < 200; i++)
+        shared.pushBack(2 * i, 4 * i);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> taken(0);
+
+    std::vector<std::thread> readers;
+    for(int i = 0; i < READERS; i++)
+        readers.push_back(std::thread(reader, std::cref(shared), std::cref(stop), std::ref(taken)));
+
+    //single writer, keys stay even and sorted, odd ones come and go
+    std::srand(7);
+    for(int i = 0; i < WRITES; i++){
+        int key = 2 * (std::rand() % 200);
+
+        switch(i % 8){
+            case 0: case 1: case 2:
+                if(shared.insertAfter(key, 2 * key, key + 1, 2 * key + 2))
+                    check(shared.remove(key + 1, 2 * key + 2), "inserted element can't be removed");
+                break;
+            case 3:
+                shared.insertBefore(key, 2 * key, key - 1, 2 * key - 2);
+                shared.remove(key - 1, 2 * key - 2);
+                break;
+            case 4: {
+                SequenceBatch<int, int> batch;
+                batch.insertAfter(key, 2 * key, key + 1, 2 * key + 2);
+                batch.remove(key + 1, 2 * key + 2);
+                shared.apply(batch);
+                break;
+            }
+            case 5:
+                shared.update([](Sequence<int, int> &sequence){ sequence.pushFront(-1, -2); });
+                shared.remove(-1, -2);
+                break;
+            case 6:
+                shared.reclaim();
+                break;
+            default:
+                shared.pushFront(-2, -4);
+                shared.remove(-2, -4);
+                break;
+        }
+    }
+
+    stop.store(true);
+    for(unsigned int i = 0; i < readers.size(); i++)
+        readers[i].join();
+
+    Shared::Snapshot last = shared.snapshot();
+    check(last->length() == 200, "writes didn't leave the original length");
+    checksum(*last);
+
+    std::printf("ok, %ld snapshots taken\n", taken.load());
+    return 0;
+}